@@ -0,0 +1,124 @@
+#include "arena.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<quint64> s_requests(0);
+std::atomic<quint64> s_systemAllocations(0);
+std::atomic<qint64> s_capacity(0);
+
+// Смещение от base, при котором адрес выровнен на alignment
+inline size_t alignedOffset(const char *base, size_t offset, size_t alignment)
+{
+    const quintptr address = quintptr(base) + offset;
+    return offset + ((alignment - address % alignment) % alignment);
+}
+
+} // namespace
+
+Arena::Arena(size_t blockSize)
+    : m_blockSize(blockSize)
+{
+}
+
+Arena::~Arena()
+{
+    release();
+}
+
+Arena &Arena::local()
+{
+    thread_local Arena arena;
+    return arena;
+}
+
+Arena::Counters Arena::counters()
+{
+    Counters result;
+    result.requests = s_requests.load(std::memory_order_relaxed);
+    result.systemAllocations = s_systemAllocations.load(std::memory_order_relaxed);
+    result.capacity = s_capacity.load(std::memory_order_relaxed);
+    return result;
+}
+
+void *Arena::allocate(size_t size, size_t alignment)
+{
+    s_requests.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0)
+        size = 1;
+
+    while (m_current < int(m_blocks.size())) {
+        Block &block = m_blocks[m_current];
+        const size_t offset = alignedOffset(block.data, m_offset, alignment);
+        if (offset + size <= block.size) {
+            m_offset = offset + size;
+            return block.data + offset;
+        }
+        ++m_current;
+        m_offset = 0;
+    }
+
+    addBlock(size + alignment);
+    Block &block = m_blocks.back();
+    const size_t offset = alignedOffset(block.data, 0, alignment);
+    m_offset = offset + size;
+    return block.data + offset;
+}
+
+void Arena::rewind(const Mark &mark)
+{
+    m_current = mark.block;
+    m_offset = mark.offset;
+}
+
+void Arena::reset()
+{
+    if (m_blocks.size() > 1) {
+        const size_t total = capacity();
+        release();
+        addBlock(total);
+    }
+    m_current = 0;
+    m_offset = 0;
+}
+
+void Arena::release()
+{
+    for (const Block &block : m_blocks) {
+        std::free(block.data);
+        s_capacity.fetch_sub(qint64(block.size), std::memory_order_relaxed);
+    }
+    m_blocks.clear();
+    m_current = 0;
+    m_offset = 0;
+}
+
+size_t Arena::bytesUsed() const
+{
+    size_t used = 0;
+    for (int i = 0; i < m_current && i < int(m_blocks.size()); ++i)
+        used += m_blocks[i].size;
+    return used + m_offset;
+}
+
+size_t Arena::capacity() const
+{
+    size_t total = 0;
+    for (const Block &block : m_blocks)
+        total += block.size;
+    return total;
+}
+
+void Arena::addBlock(size_t minimumSize)
+{
+    const size_t size = qMax(m_blockSize, minimumSize);
+    char *data = static_cast<char *>(std::malloc(size));
+    if (!data)
+        throw std::bad_alloc();
+    s_systemAllocations.fetch_add(1, std::memory_order_relaxed);
+    s_capacity.fetch_add(qint64(size), std::memory_order_relaxed);
+    m_blocks.push_back({data, size});
+    m_current = int(m_blocks.size()) - 1;
+}
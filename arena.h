@@ -0,0 +1,120 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <QtGlobal>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+// Линейный распределитель для временных данных одной операции: память
+// выдаётся сдвигом указателя и освобождается разом. Блоки сохраняются
+// между операциями, поэтому в установившемся режиме операция не обращается
+// к системному распределителю. У каждого потока своя арена: Arena::local().
+class Arena
+{
+public:
+    struct Mark
+    {
+        int block = 0;
+        size_t offset = 0;
+    };
+
+    // Счётчики по всем аренам процесса
+    struct Counters
+    {
+        quint64 requests = 0;
+        quint64 systemAllocations = 0;
+        // Байты, занятые блоками всех арен
+        qint64 capacity = 0;
+    };
+
+    explicit Arena(size_t blockSize = 256 * 1024);
+    ~Arena();
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    static Arena &local();
+    static Counters counters();
+
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    // Массив без инициализации; только для тривиальных типов
+    template <typename T>
+    T *allocateArray(size_t count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "arena never runs destructors");
+        return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    Mark mark() const { return {m_current, m_offset}; }
+    void rewind(const Mark &mark);
+    // Освобождает всё; если операция не уместилась в один блок, блоки
+    // сливаются в один, чтобы следующая уместилась
+    void reset();
+    // Возвращает блоки системе; только когда из арены ничего не выделено
+    void release();
+
+    size_t bytesUsed() const;
+    size_t capacity() const;
+
+private:
+    struct Block
+    {
+        char *data;
+        size_t size;
+    };
+
+    void addBlock(size_t minimumSize);
+
+    std::vector<Block> m_blocks;
+    int m_current = 0;
+    size_t m_offset = 0;
+    size_t m_blockSize;
+};
+
+// Возвращает арену к отметке при выходе из области видимости
+class ArenaScope
+{
+public:
+    explicit ArenaScope(Arena &arena = Arena::local()) : m_arena(arena), m_mark(arena.mark()) {}
+    ~ArenaScope() { m_arena.rewind(m_mark); }
+
+    ArenaScope(const ArenaScope &) = delete;
+    ArenaScope &operator=(const ArenaScope &) = delete;
+
+private:
+    Arena &m_arena;
+    Arena::Mark m_mark;
+};
+
+// Распределитель для стандартных контейнеров; освобождение — без действия,
+// память возвращается вместе с ареной
+template <typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena &arena = Arena::local()) : m_arena(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : m_arena(other.arena()) {}
+
+    T *allocate(size_t count) { return static_cast<T *>(m_arena->allocate(sizeof(T) * count, alignof(T))); }
+    void deallocate(T *, size_t) {}
+
+    Arena *arena() const { return m_arena; }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const { return m_arena == other.arena(); }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const { return m_arena != other.arena(); }
+
+private:
+    Arena *m_arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif // ARENA_H
@@ -0,0 +1,365 @@
+#include "benchmark.h"
+#include "arena.h"
+#include "fillmask.h"
+#include "fillregion.h"
+#include "hatchingtool.h"
+#include "hatchpatterncache.h"
+#include "layerstack.h"
+#include "scanprocessor.h"
+#include "strokeprocessor.h"
+#include "strokerasterizer.h"
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QPainter>
+#include <QRandomGenerator>
+#include <QTextStream>
+
+namespace {
+
+const int PencilSegments = 5000;
+
+// Ломаная из коротких отрезков, как при движении мыши
+QVector<QPoint> mouseTrail(int count, const QSize &area)
+{
+    QRandomGenerator rng(42);
+    QVector<QPoint> points;
+    points.reserve(count + 1);
+
+    QPoint p(area.width() / 2, area.height() / 2);
+    points.append(p);
+    for (int i = 0; i < count; ++i) {
+        p += QPoint(rng.bounded(-5, 6), rng.bounded(-5, 6));
+        p.setX(qBound(0, p.x(), area.width() - 1));
+        p.setY(qBound(0, p.y(), area.height() - 1));
+        points.append(p);
+    }
+    return points;
+}
+
+// Лист с сеткой замкнутых прямоугольных ячеек
+QImage cellSheet(const QSize &size, int cell)
+{
+    QImage image(size, QImage::Format_RGB32);
+    image.fill(Qt::white);
+    QPainter painter(&image);
+    painter.setPen(QPen(Qt::black, 2));
+    for (int x = 0; x < size.width(); x += cell)
+        painter.drawLine(x, 0, x, size.height());
+    for (int y = 0; y < size.height(); y += cell)
+        painter.drawLine(0, y, size.width(), y);
+    return image;
+}
+
+Result makeResult(const QString &name, qint64 nsecs, int operations)
+{
+    Result result;
+    result.name = name;
+    result.operations = operations;
+    result.nsPerOp = double(nsecs) / qMax(1, operations);
+    return result;
+}
+
+} // namespace
+
+namespace Benchmark {
+
+QVector<Result> runPencil()
+{
+    QVector<Result> results;
+    const QSize size(1024, 1024);
+    const QVector<QPoint> trail = mouseTrail(PencilSegments, size);
+    const int widths[] = {1, 2, 5, 10, 20, 50};
+
+    for (int width : widths) {
+        // Формат слоя контуров
+        QImage image(size, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::white);
+
+        QElapsedTimer timer;
+        {
+            QPainter painter(&image);
+            painter.setRenderHint(QPainter::Antialiasing, true);
+            timer.start();
+            for (int i = 1; i < trail.size(); ++i) {
+                painter.setPen(QPen(Qt::blue, width, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+                painter.drawLine(trail[i - 1], trail[i]);
+            }
+        }
+        results.append(makeResult(QString("pencil/qpainter/w=%1").arg(width),
+                                  timer.nsecsElapsed(), PencilSegments));
+
+        image.fill(Qt::white);
+        timer.start();
+        StrokeRasterizer rasterizer(image);
+        rasterizer.setColor(Qt::blue);
+        rasterizer.setWidth(width);
+        for (int i = 1; i < trail.size(); ++i)
+            rasterizer.drawSegment(trail[i - 1], trail[i]);
+        results.append(makeResult(QString("pencil/rasterizer/w=%1").arg(width),
+                                  timer.nsecsElapsed(), PencilSegments));
+    }
+    return results;
+}
+
+QVector<Result> runStrokeProcessing()
+{
+    const QVector<QPoint> trail = mouseTrail(PencilSegments, QSize(1024, 1024));
+
+    StrokeProcessor processor;
+    QElapsedTimer timer;
+    timer.start();
+    processor.begin(trail.first(), 0);
+    QPointF vertex;
+    for (int i = 1; i < trail.size(); ++i)
+        processor.addPoint(trail[i], i * 8, vertex);
+    processor.finish(vertex);
+    const qint64 elapsed = timer.nsecsElapsed();
+
+    Result result = makeResult("stroke/process", elapsed, trail.size());
+    result.name += QString(" (%1 -> %2 points)").arg(processor.inputCount()).arg(processor.points().size());
+    return {result};
+}
+
+QVector<Result> runComposition()
+{
+    QVector<Result> results;
+    const QSize size(1920, 1080);
+    const QRect frame(QPoint(0, 0), size);
+    const int frames = 100;
+
+    QImage screen(size, QImage::Format_RGB32);
+    QImage single(size, QImage::Format_RGB32);
+    single.fill(Qt::white);
+
+    QElapsedTimer timer;
+    {
+        QPainter painter(&screen);
+        timer.start();
+        for (int i = 0; i < frames; ++i)
+            painter.drawImage(frame, single, frame);
+    }
+    results.append(makeResult("frame/single-image", timer.nsecsElapsed(), frames));
+
+    // Вывод кадра большого окна на экран из изображений разных форматов
+    const QSize large(3840, 2160);
+    const QRect largeFrame(QPoint(0, 0), large);
+    QImage largeScreen(large, QImage::Format_RGB32);
+    const struct {
+        QImage::Format format;
+        const char *name;
+    } formats[] = {
+        {QImage::Format_ARGB32, "argb32"},
+        {QImage::Format_ARGB32_Premultiplied, "argb32-premultiplied"},
+        {QImage::Format_RGB32, "rgb32"},
+    };
+    for (const auto &entry : formats) {
+        QImage source(large, entry.format);
+        source.fill(Qt::white);
+        const int blits = 20;
+        {
+            QPainter painter(&largeScreen);
+            timer.start();
+            for (int i = 0; i < blits; ++i)
+                painter.drawImage(largeFrame, source, largeFrame);
+        }
+        results.append(makeResult(QString("frame/blit-4k/%1").arg(entry.name), timer.nsecsElapsed(), blits));
+    }
+
+    LayerStack layers;
+    layers.resize(size);
+    layers.composite(frame);
+    {
+        QPainter painter(&screen);
+        timer.start();
+        for (int i = 0; i < frames; ++i) {
+            // Каждый кадр меняется небольшой участок контуров, как при рисовании
+            const QRect stroke(QPoint((i * 37) % 1800, (i * 23) % 1000), QSize(64, 64));
+            layers.markDirty(LayerStack::OutlineLayer, stroke);
+            painter.drawImage(frame, layers.composite(frame), frame);
+        }
+    }
+    results.append(makeResult("frame/layers-cached", timer.nsecsElapsed(), frames));
+    return results;
+}
+
+QVector<Result> runHatching()
+{
+    QVector<Result> results;
+    const QImage sheet = cellSheet(QSize(1024, 1024), 256);
+    const QPoint seed(128, 128);
+    const int fills = 50;
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 area = 0;
+    for (int i = 0; i < fills; ++i)
+        area += FillRegion::fromSeed(sheet, seed).area();
+    results.append(makeResult("fill/scanline", timer.nsecsElapsed(), fills));
+
+    // Обе маски строятся заново на каждую заливку, как при первом клике
+    const FillMask::Mode modes[] = {FillMask::ExactMatch, FillMask::AntialiasAware};
+    for (FillMask::Mode mode : modes) {
+        timer.start();
+        for (int i = 0; i < fills; ++i) {
+            FillMask mask;
+            mask.reset(&sheet, 0, sheet.pixel(seed), qRgb(0, 0, 0), mode);
+            area += FillRegion::fromSeed(mask, seed).area();
+        }
+        results.append(makeResult(mode == FillMask::ExactMatch ? "fill/mask-exact" : "fill/mask-antialiased",
+                                  timer.nsecsElapsed(), fills));
+    }
+
+    // После первой заливки арена потока уже достаточно велика
+    const Arena::Counters before = Arena::counters();
+    FillMask steadyMask;
+    steadyMask.reset(&sheet, 0, sheet.pixel(seed), qRgb(0, 0, 0), FillMask::ExactMatch);
+    timer.start();
+    for (int i = 0; i < fills; ++i)
+        area += FillRegion::fromSeed(steadyMask, seed).area();
+    Result steady = makeResult("fill/arena-steady", timer.nsecsElapsed(), fills);
+    const Arena::Counters after = Arena::counters();
+    steady.name += QString(" (%1 blocks allocated for %2 requests)")
+                       .arg(after.systemAllocations - before.systemAllocations)
+                       .arg(after.requests - before.requests);
+    results.append(steady);
+    Q_UNUSED(area);
+
+    const FillRegion region = FillRegion::fromSeed(sheet, seed);
+    QImage target(sheet.size(), QImage::Format_ARGB32_Premultiplied);
+    HatchPatternCache cache;
+    HatchPattern pattern;
+    cache.tile(pattern);
+
+    timer.start();
+    for (int i = 0; i < fills; ++i)
+        HatchPatternCache::fillSpans(cache.tile(pattern), region.spans(), target);
+    results.append(makeResult("hatch/tile-spans", timer.nsecsElapsed(), fills));
+
+    for (int angle = 0; angle < 180; angle += 15) {
+        pattern.angle = angle;
+        timer.start();
+        cache.tile(pattern);
+        results.append(makeResult(QString("hatch/build-tile/angle=%1").arg(angle), timer.nsecsElapsed(), 1));
+    }
+
+    // Каждое ядро: построение плитки заново и заливка ею области
+    for (int family = 0; family < HatchKernels::FamilyCount; ++family) {
+        HatchPattern kernelPattern;
+        kernelPattern.family = HatchKernels::Family(family);
+        kernelPattern.spacing = 8;
+        const QString name = HatchKernels::Families[family].name;
+
+        const int builds = 20;
+        timer.start();
+        for (int i = 0; i < builds; ++i) {
+            cache.clear();
+            cache.tile(kernelPattern);
+        }
+        const QImage &kernelTile = cache.tile(kernelPattern);
+        Result build = makeResult(QString("hatch/kernel/%1/build").arg(name), timer.nsecsElapsed(), builds);
+        build.name += QString(" (%1x%2 tile)").arg(kernelTile.width()).arg(kernelTile.height());
+        results.append(build);
+
+        timer.start();
+        for (int i = 0; i < fills; ++i)
+            HatchPatternCache::fillSpans(kernelTile, region.spans(), target);
+        results.append(makeResult(QString("hatch/kernel/%1/fill").arg(name), timer.nsecsElapsed(), fills));
+    }
+
+    // 16 ячеек одной операцией и по одной
+    QVector<QPoint> seeds;
+    for (int y = 128; y < 1024; y += 256)
+        for (int x = 128; x < 1024; x += 256)
+            seeds.append(QPoint(x, y));
+    {
+        HatchingTool batchTool;
+        batchTool.setBoundaryImage(&sheet, 1);
+        timer.start();
+        batchTool.hatchSeeds(seeds, target);
+        results.append(makeResult("hatch/batch-16-cells", timer.nsecsElapsed(), 1));
+    }
+    {
+        HatchingTool batchTool;
+        batchTool.setBoundaryImage(&sheet, 1);
+        timer.start();
+        for (const QPoint &cellSeed : std::as_const(seeds))
+            batchTool.hatchSeeds({cellSeed}, target);
+        results.append(makeResult("hatch/sequential-16-cells", timer.nsecsElapsed(), 1));
+    }
+
+    HatchingTool tool;
+    tool.setBoundaryImage(&sheet, 1);
+    const int moves = 1000;
+
+    timer.start();
+    tool.updatePreview(seed);
+    results.append(makeResult("hatch/preview-miss", timer.nsecsElapsed(), 1));
+
+    timer.start();
+    for (int i = 0; i < moves; ++i)
+        tool.updatePreview(seed + QPoint(i % 64, i % 32));
+    results.append(makeResult("hatch/preview-hit", timer.nsecsElapsed(), moves));
+    return results;
+}
+
+QVector<Result> runScanProcessing()
+{
+    QVector<Result> results;
+    const QSize size(2048, 2048);
+
+    // Скан: сетка на неравномерно освещённой бумаге с крапинами
+    QImage scan = cellSheet(size, 128);
+    QRandomGenerator rng(42);
+    for (int y = 0; y < size.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(scan.scanLine(y));
+        for (int x = 0; x < size.width(); ++x) {
+            const int shade = (x + y) * 60 / (size.width() + size.height());
+            int value = qGray(line[x]) - shade;
+            if (rng.bounded(500) == 0)
+                value = 0;
+            value = qBound(0, value, 255);
+            line[x] = qRgb(value, value, value);
+        }
+    }
+
+    const int pixels = size.width() * size.height();
+    const bool thinningModes[] = {false, true};
+    for (bool thinning : thinningModes) {
+        ScanProcessor::Options options;
+        options.thinning = thinning;
+        ScanProcessor::Stats stats;
+        ScanProcessor(options).process(scan, &stats);
+
+        Result result = makeResult(thinning ? "scan/binarize+thinning" : "scan/binarize",
+                                   stats.nsecs, pixels);
+        result.name += QString(" (%1 MP/s)").arg(stats.megapixelsPerSecond, 0, 'f', 1);
+        results.append(result);
+    }
+    return results;
+}
+
+QVector<Result> runAll()
+{
+    QVector<Result> results;
+    results += runPencil();
+    results += runStrokeProcessing();
+    results += runComposition();
+    results += runHatching();
+    results += runScanProcessing();
+    return results;
+}
+
+void print(const QVector<Result> &results)
+{
+    QTextStream out(stdout);
+    for (const Result &result : results) {
+        out << QString("%1 %2 ns/op (%3 ops)")
+                   .arg(result.name, -32)
+                   .arg(result.nsPerOp, 12, 'f', 1)
+                   .arg(result.operations)
+            << '\n';
+    }
+}
+
+} // namespace Benchmark
@@ -0,0 +1,28 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QString>
+#include <QVector>
+
+// Замеры производительности горячих путей рисования (запуск: --benchmark)
+namespace Benchmark {
+
+struct Result
+{
+    QString name;
+    double nsPerOp = 0;
+    int operations = 0;
+};
+
+QVector<Result> runPencil();
+QVector<Result> runStrokeProcessing();
+QVector<Result> runComposition();
+QVector<Result> runHatching();
+QVector<Result> runScanProcessing();
+QVector<Result> runAll();
+
+void print(const QVector<Result> &results);
+
+} // namespace Benchmark
+
+#endif // BENCHMARK_H
@@ -0,0 +1,140 @@
+#include "fillmask.h"
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Пиксель считается краем линии, пока доля пера в нём меньше этого порога
+const float CoreThreshold = 0.75f;
+// Допустимое отклонение цвета от смеси цвета области и пера (на канал)
+const float ColorTolerance = 12.0f;
+
+} // namespace
+
+void FillMask::reset(const QImage *image, quint64 key, QRgb target, QRgb pen, Mode mode)
+{
+    m_source = image;
+    m_image = image;
+    m_key = key;
+    m_target = target;
+    m_pen = pen;
+    m_mode = mode;
+    m_width = image->width();
+    m_height = image->height();
+
+    if (image->depth() == 32) {
+        m_converted = QImage();
+    } else {
+        m_converted = image->convertToFormat(QImage::Format_ARGB32);
+        m_image = &m_converted;
+    }
+
+    m_mask.resize(size_t(m_width) * size_t(m_height));
+    m_rowReady.assign(size_t(m_height), 0);
+}
+
+bool FillMask::matches(const QImage *image, quint64 key, QRgb target, QRgb pen, Mode mode) const
+{
+    if (m_source != image || m_mode != mode || m_key != key || m_target != target)
+        return false;
+    return mode == ExactMatch || m_pen == pen;
+}
+
+qint64 FillMask::bytes() const
+{
+    return qint64(m_mask.capacity() + m_rowReady.capacity()) + m_converted.sizeInBytes();
+}
+
+qint64 FillMask::release()
+{
+    const qint64 freed = bytes();
+    m_source = nullptr;
+    m_image = nullptr;
+    m_converted = QImage();
+    m_width = 0;
+    m_height = 0;
+    std::vector<uchar>().swap(m_mask);
+    std::vector<uchar>().swap(m_rowReady);
+    return freed;
+}
+
+void FillMask::classifyRow(int y)
+{
+    const QRgb *src = reinterpret_cast<const QRgb *>(m_image->constScanLine(y));
+    uchar *dst = m_mask.data() + size_t(y) * size_t(m_width);
+    m_rowReady[size_t(y)] = 1;
+    int x = 0;
+
+    const float dr = float(qRed(m_pen) - qRed(m_target));
+    const float dg = float(qGreen(m_pen) - qGreen(m_target));
+    const float db = float(qBlue(m_pen) - qBlue(m_target));
+    const float dd = dr * dr + dg * dg + db * db;
+
+    if (m_mode == ExactMatch || dd < 1.0f) {
+        const QRgb target = m_target;
+#ifdef __SSE2__
+        const __m128i targetVector = _mm_set1_epi32(int(target));
+        for (; x + 4 <= m_width; x += 4) {
+            const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+            const int bits = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(pixels, targetVector)));
+            for (int i = 0; i < 4; ++i)
+                dst[x + i] = uchar((bits >> i) & 1);
+        }
+#endif
+        for (; x < m_width; ++x)
+            dst[x] = src[x] == target ? 1 : 0;
+        return;
+    }
+
+    // Пиксель p = target + t * (pen - target) + остаток: принадлежит области,
+    // если он лежит на отрезке от цвета области к цвету пера (с допуском
+    // tol за цветом области) и остаток мал. Проверки без деления:
+    //   -tol * |d| <= dot < CoreThreshold * dd,  |p - target|^2 * dd - dot^2 <= tol^2 * dd
+    // Без нижней границы в область попадали бы цвета по другую сторону от
+    // цвета области, например белая бумага рядом с серой заливкой
+    const float tr = float(qRed(m_target));
+    const float tg = float(qGreen(m_target));
+    const float tb = float(qBlue(m_target));
+    const float lowLimit = -ColorTolerance * std::sqrt(3 * dd);
+    const float coreLimit = CoreThreshold * dd;
+    const float residualLimit = 3 * ColorTolerance * ColorTolerance * dd;
+
+#ifdef __SSE2__
+    const __m128i byteMask = _mm_set1_epi32(0xff);
+    const __m128 vtr = _mm_set1_ps(tr), vtg = _mm_set1_ps(tg), vtb = _mm_set1_ps(tb);
+    const __m128 vdr = _mm_set1_ps(dr), vdg = _mm_set1_ps(dg), vdb = _mm_set1_ps(db);
+    const __m128 vdd = _mm_set1_ps(dd);
+    const __m128 vlow = _mm_set1_ps(lowLimit);
+    const __m128 vcore = _mm_set1_ps(coreLimit);
+    const __m128 vresidual = _mm_set1_ps(residualLimit);
+
+    for (; x + 4 <= m_width; x += 4) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+        const __m128 r = _mm_sub_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 16), byteMask)), vtr);
+        const __m128 g = _mm_sub_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 8), byteMask)), vtg);
+        const __m128 b = _mm_sub_ps(_mm_cvtepi32_ps(_mm_and_si128(pixels, byteMask)), vtb);
+
+        const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, vdr), _mm_mul_ps(g, vdg)), _mm_mul_ps(b, vdb));
+        const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, r), _mm_mul_ps(g, g)), _mm_mul_ps(b, b));
+        const __m128 residual = _mm_sub_ps(_mm_mul_ps(d2, vdd), _mm_mul_ps(dot, dot));
+
+        const __m128 onSegment = _mm_and_ps(_mm_cmpge_ps(dot, vlow), _mm_cmplt_ps(dot, vcore));
+        const __m128 inside = _mm_and_ps(onSegment, _mm_cmple_ps(residual, vresidual));
+        const int bits = _mm_movemask_ps(inside);
+        for (int i = 0; i < 4; ++i)
+            dst[x + i] = uchar((bits >> i) & 1);
+    }
+#endif
+    for (; x < m_width; ++x) {
+        const float r = float(qRed(src[x])) - tr;
+        const float g = float(qGreen(src[x])) - tg;
+        const float b = float(qBlue(src[x])) - tb;
+        const float dot = r * dr + g * dg + b * db;
+        const float residual = (r * r + g * g + b * b) * dd - dot * dot;
+        dst[x] = (dot >= lowLimit && dot < coreLimit && residual <= residualLimit) ? 1 : 0;
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef FILLMASK_H
+#define FILLMASK_H
+
+#include <QImage>
+#include <QRgb>
+#include <vector>
+
+// Классификация пикселей изображения контуров для заливки: 1 — пиксель
+// принадлежит области, 0 — граница. Строки классифицируются лениво при
+// первом обращении, результат живёт до смены изображения или цветов.
+class FillMask
+{
+public:
+    enum Mode {
+        // Только пиксели, в точности совпадающие с цветом области
+        ExactMatch,
+        // Также сглаженные края линий: смесь цвета области и цвета пера
+        // с долей пера меньше порога
+        AntialiasAware
+    };
+
+    FillMask() = default;
+
+    // key отличает версии одного и того же изображения (ревизия контуров)
+    void reset(const QImage *image, quint64 key, QRgb target, QRgb pen, Mode mode);
+    bool matches(const QImage *image, quint64 key, QRgb target, QRgb pen, Mode mode) const;
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+    const uchar *row(int y)
+    {
+        if (!m_rowReady[size_t(y)])
+            classifyRow(y);
+        return m_mask.data() + size_t(y) * size_t(width());
+    }
+
+    qint64 bytes() const;
+    // Освобождает память; маска перестаёт совпадать с любым изображением
+    qint64 release();
+
+private:
+    void classifyRow(int y);
+
+    const QImage *m_source = nullptr;
+    const QImage *m_image = nullptr;
+    QImage m_converted;
+    quint64 m_key = 0;
+    int m_width = 0;
+    int m_height = 0;
+    QRgb m_target = 0;
+    QRgb m_pen = 0;
+    Mode m_mode = ExactMatch;
+
+    std::vector<uchar> m_mask;
+    std::vector<uchar> m_rowReady;
+};
+
+#endif // FILLMASK_H
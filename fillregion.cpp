@@ -0,0 +1,163 @@
+#include "fillregion.h"
+#include "arena.h"
+#include "fillmask.h"
+#include <algorithm>
+#include <cstring>
+
+FillRegion FillRegion::fromSeed(const QImage &image, const QPoint &seed)
+{
+    if (!image.rect().contains(seed))
+        return FillRegion();
+
+    FillMask mask;
+    mask.reset(&image, 0, image.pixel(seed), image.pixel(seed), FillMask::ExactMatch);
+    return fromSeed(mask, seed);
+}
+
+FillRegion FillRegion::fromSeed(FillMask &mask, const QPoint &seed, uchar *sharedVisited)
+{
+    FillRegion region;
+    region.m_seed = seed;
+    const int width = mask.width();
+    const int height = mask.height();
+    if (seed.x() < 0 || seed.y() < 0 || seed.x() >= width || seed.y() >= height)
+        return region;
+
+    // Временные данные заливки живут в арене потока и освобождаются на выходе
+    Arena &arena = Arena::local();
+    ArenaScope scope(arena);
+
+    uchar *visited = sharedVisited;
+    if (!visited) {
+        visited = arena.allocateArray<uchar>(size_t(width) * height);
+        std::memset(visited, 0, size_t(width) * height);
+    }
+
+    auto inside = [&](int x, int y) {
+        return !visited[size_t(y) * width + x] && mask.row(y)[x];
+    };
+
+    // Измерения набираются по отрезкам во время обхода. Соседний по
+    // вертикали пиксель маски связан с отрезком, значит, принадлежит
+    // области, поэтому открытые стороны видны по той же маске
+    qint64 perimeter = 0;
+    qint64 sumX2 = 0;
+    qint64 sumY2 = 0;
+
+    // В стек попадает одна точка на каждый непрерывный участок соседней строки
+    ArenaVector<QPoint> stack{ArenaAllocator<QPoint>(arena)};
+    stack.reserve(1024);
+    stack.push_back(seed);
+    ArenaVector<FillSpan> spans{ArenaAllocator<FillSpan>(arena)};
+    spans.reserve(1024);
+
+    while (!stack.empty()) {
+        const QPoint p = stack.back();
+        stack.pop_back();
+        const int y = p.y();
+        if (!inside(p.x(), y))
+            continue;
+
+        int x1 = p.x();
+        int x2 = p.x();
+        while (x1 > 0 && inside(x1 - 1, y))
+            --x1;
+        while (x2 < width - 1 && inside(x2 + 1, y))
+            ++x2;
+
+        const qint64 length = x2 - x1 + 1;
+        std::memset(visited + size_t(y) * width + x1, 1, size_t(length));
+        spans.push_back({y, x1, x2});
+        sumX2 += length * (x1 + x2 + 1);
+        sumY2 += length * (2 * y + 1);
+        perimeter += 2;
+
+        for (int ny = y - 1; ny <= y + 1; ny += 2) {
+            if (ny < 0 || ny >= height) {
+                perimeter += length;
+                continue;
+            }
+            const uchar *maskRow = mask.row(ny);
+            const uchar *visitedRow = visited + size_t(ny) * width;
+            bool previousInside = false;
+            for (int x = x1; x <= x2; ++x) {
+                perimeter += !maskRow[x];
+                const bool isInside = maskRow[x] && !visitedRow[x];
+                if (isInside && !previousInside)
+                    stack.push_back(QPoint(x, ny));
+                previousInside = isInside;
+            }
+        }
+    }
+
+    // Результат копируется из арены одним выделением памяти
+    region.m_spans.resize(int(spans.size()));
+    std::copy(spans.cbegin(), spans.cend(), region.m_spans.begin());
+    region.m_perimeter = perimeter;
+    region.m_sumX2 = sumX2;
+    region.m_sumY2 = sumY2;
+    region.finalize();
+    return region;
+}
+
+QPointF FillRegion::centroid() const
+{
+    if (m_area == 0)
+        return QPointF();
+    return QPointF(m_sumX2 / (2.0 * m_area), m_sumY2 / (2.0 * m_area));
+}
+
+bool FillRegion::contains(const QPoint &point) const
+{
+    if (!m_bounds.contains(point))
+        return false;
+
+    auto it = std::lower_bound(m_spans.cbegin(), m_spans.cend(), point.y(),
+                               [](const FillSpan &span, int y) { return span.y < y; });
+    for (; it != m_spans.cend() && it->y == point.y(); ++it) {
+        if (point.x() >= it->x1 && point.x() <= it->x2)
+            return true;
+    }
+    return false;
+}
+
+bool FillRegion::intersects(const FillRegion &other) const
+{
+    if (!m_bounds.intersects(other.m_bounds))
+        return false;
+
+    auto a = m_spans.cbegin();
+    auto b = other.m_spans.cbegin();
+    while (a != m_spans.cend() && b != other.m_spans.cend()) {
+        if (a->y != b->y) {
+            (a->y < b->y ? a : b)++;
+            continue;
+        }
+        if (a->x1 <= b->x2 && b->x1 <= a->x2)
+            return true;
+        // Отрезки строки отсортированы по x1; сдвигается тот, что кончается раньше
+        (a->x2 < b->x2 ? a : b)++;
+    }
+    return false;
+}
+
+void FillRegion::finalize()
+{
+    std::sort(m_spans.begin(), m_spans.end(), [](const FillSpan &a, const FillSpan &b) {
+        return a.y < b.y || (a.y == b.y && a.x1 < b.x1);
+    });
+
+    m_area = 0;
+    m_bounds = QRect();
+    if (m_spans.isEmpty())
+        return;
+
+    int minX = m_spans.first().x1;
+    int maxX = m_spans.first().x2;
+    for (const FillSpan &span : std::as_const(m_spans)) {
+        minX = qMin(minX, span.x1);
+        maxX = qMax(maxX, span.x2);
+        m_area += span.x2 - span.x1 + 1;
+    }
+    m_bounds = QRect(QPoint(minX, m_spans.first().y), QPoint(maxX, m_spans.last().y));
+}
@@ -0,0 +1,64 @@
+#ifndef FILLREGION_H
+#define FILLREGION_H
+
+#include <QImage>
+#include <QPoint>
+#include <QPointF>
+#include <QRect>
+#include <QVector>
+
+class FillMask;
+
+// Горизонтальный отрезок области: строка y, столбцы с x1 по x2 включительно
+struct FillSpan
+{
+    int y;
+    int x1;
+    int x2;
+};
+
+// Связная область заливки в виде отсортированного списка отрезков
+class FillRegion
+{
+public:
+    FillRegion() = default;
+
+    // Построчная заливка от seed по пикселям, отмеченным в маске.
+    // visited (ширина × высота маски) можно передать общим для нескольких
+    // заливок: пиксели уже найденных областей повторно не обходятся.
+    // Без него карта обхода и стек берутся из арены потока (arena.h)
+    static FillRegion fromSeed(FillMask &mask, const QPoint &seed,
+                               uchar *visited = nullptr);
+    // То же по пикселям точно того же цвета, что и seed
+    static FillRegion fromSeed(const QImage &image, const QPoint &seed);
+
+    bool isEmpty() const { return m_spans.isEmpty(); }
+    const QVector<FillSpan> &spans() const { return m_spans; }
+    QRect boundingRect() const { return m_bounds; }
+    qint64 area() const { return m_area; }
+    // Число открытых сторон пикселей области, включая стороны у дыр.
+    // Считается по ступенчатой границе, поэтому для наклонных краёв
+    // больше евклидовой длины (до √2 раз на 45°)
+    qint64 perimeter() const { return m_perimeter; }
+    // Центр тяжести в координатах изображения; центр пикселя x — x + 0.5
+    QPointF centroid() const;
+    QPoint seed() const { return m_seed; }
+
+    bool contains(const QPoint &point) const;
+    // Есть ли общие пиксели; один проход по обоим спискам отрезков
+    bool intersects(const FillRegion &other) const;
+
+private:
+    void finalize();
+
+    QVector<FillSpan> m_spans;
+    QRect m_bounds;
+    qint64 m_area = 0;
+    qint64 m_perimeter = 0;
+    // Суммы удвоенных координат центров пикселей
+    qint64 m_sumX2 = 0;
+    qint64 m_sumY2 = 0;
+    QPoint m_seed;
+};
+
+#endif // FILLREGION_H
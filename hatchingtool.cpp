@@ -1,9 +1,63 @@
 #include "hatchingtool.h"
+#include "arena.h"
+#include "parallel.h"
 #include <QPainter>
 #include <QMouseEvent>
-#include <QStack>
-#include <QDebug>
-#include <cmath>
+#include <QLoggingCategory>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+// Статистика заливок; по умолчанию выключена,
+// включается через QT_LOGGING_RULES="draft.hatching.debug=true"
+Q_LOGGING_CATEGORY(lcHatching, "draft.hatching", QtWarningMsg)
+
+namespace {
+
+// Рисунок штриховки материалов по ГОСТ 2.306, в порядке HatchingTool::HatchType
+struct MaterialPreset
+{
+    HatchKernels::Family family;
+    int angle;
+    int spacing;
+    bool cross;
+};
+
+constexpr MaterialPreset MaterialPresets[] = {
+    {HatchKernels::Parallel, 45, 5, false},          // Metal
+    {HatchKernels::Parallel, 45, 4, true},           // NonMetal
+    {HatchKernels::WoodGrain, 0, 4, false},          // Wood
+    {HatchKernels::Parallel, 45, 6, false},          // Stone
+    {HatchKernels::Parallel, 45, 5, false},          // Ceramic
+    {HatchKernels::ConcreteAggregate, 45, 8, false}, // Concrete
+    {HatchKernels::GlassDots, 45, 12, false},        // Glass
+    {HatchKernels::Parallel, 45, 2, false},          // Liquid
+    {HatchKernels::SoilDashes, 45, 5, false},        // Soil
+};
+
+// Проходы записи областей в слой. В режиме со сглаживанием маски разных
+// цветов могут отнести пиксели сглаженного края к обеим соседним областям,
+// поэтому пересекающиеся области попадают в разные проходы, после всех
+// пересекающихся с ними более ранних: общие пиксели пишутся в том же
+// порядке, что и без распараллеливания. Области одного прохода не
+// пересекаются и пишутся одновременно
+QVector<QVector<int>> writePasses(int count, const std::function<const FillRegion &(int)> &regionAt)
+{
+    QVector<QVector<int>> passes;
+    QVector<int> passOf(count, 0);
+    for (int i = 0; i < count; ++i) {
+        for (int j = 0; j < i; ++j) {
+            if (passOf[j] >= passOf[i] && regionAt(i).intersects(regionAt(j)))
+                passOf[i] = passOf[j] + 1;
+        }
+        if (passOf[i] >= passes.size())
+            passes.resize(passOf[i] + 1);
+        passes[passOf[i]].append(i);
+    }
+    return passes;
+}
+
+} // namespace
 
 HatchingTool::HatchingTool(QObject *parent) : Tool(parent)
 {
@@ -15,14 +69,18 @@ void HatchingTool::onMousePress(QMouseEvent *event, QPainter &painter, const QPo
     Q_UNUSED(lastPoint);
     if (event->button() == Qt::LeftButton) {
         m_isDrawing = true;
+        m_pressPoint = event->pos();
+        m_selecting = event->modifiers().testFlag(Qt::ControlModifier);
+        m_selectionRect = QRect();
     }
 }
 
 void HatchingTool::onMouseMove(QMouseEvent *event, QPainter &painter, const QPoint &lastPoint)
 {
-    Q_UNUSED(event);
     Q_UNUSED(painter);
     Q_UNUSED(lastPoint);
+    if ((event->buttons() & Qt::LeftButton) && m_selecting)
+        m_selectionRect = QRect(m_pressPoint, event->pos()).normalized();
 }
 
 void HatchingTool::onMouseRelease(QMouseEvent *event, QPainter &painter, const QPoint &lastPoint)
@@ -38,195 +96,482 @@ void HatchingTool::onMouseRelease(QMouseEvent *event, QPainter &painter, const Q
         QImage *image = static_cast<QImage*>(device);
         if (!image) return;
 
-        floodFillHatch(clickPoint, *image, painter);
+        if (m_selecting) {
+            const QRect rect = m_selectionRect;
+            m_selecting = false;
+            m_selectionRect = QRect();
+            if (rect.width() > 1 && rect.height() > 1)
+                hatchEnclosedRegions(rect, *image);
+            return;
+        }
+
+        if (event->modifiers() & Qt::ShiftModifier) {
+            m_queuedSeeds.append(clickPoint);
+            return;
+        }
+
+        if (!m_queuedSeeds.isEmpty()) {
+            m_queuedSeeds.append(clickPoint);
+            commitQueue(*image);
+            return;
+        }
+
+        floodFillHatch(clickPoint, *image);
     }
 }
 
 void HatchingTool::setHatchType(HatchType type)
 {
+    const MaterialPreset &preset = MaterialPresets[type];
     m_hatchType = type;
-
-    switch (type) {
-    case Metal:
-        m_hatchAngle = 45;
-        m_hatchSpacing = 5;
-        m_crossHatching = false;
-        break;
-    case NonMetal:
-        m_hatchAngle = 45;
-        m_hatchSpacing = 4;
-        m_crossHatching = true;
-        break;
-    case Wood:
-        m_hatchAngle = 0;
-        m_hatchSpacing = 4;
-        m_crossHatching = false;
-        break;
-    case Stone:
-        m_hatchAngle = 45;
-        m_hatchSpacing = 6;
-        m_crossHatching = false;
-        break;
-    case Ceramic:
-        m_hatchAngle = 45;
-        m_hatchSpacing = 5;
-        m_crossHatching = false;
-        break;
-    case Concrete:
-        m_hatchAngle = 45;
-        m_hatchSpacing = 8;
-        m_crossHatching = false;
-        break;
-    case Glass:
-        m_hatchAngle = 45;
-        m_hatchSpacing = 12;
-        m_crossHatching = false;
-        break;
-    case Liquid:
-        m_hatchAngle = 45;
-        m_hatchSpacing = 2;
-        m_crossHatching = false;
-        break;
-    case Soil:
-        m_hatchAngle = 45;
-        m_hatchSpacing = 5;
-        m_crossHatching = false;
-        break;
-    }
+    m_hatchFamily = preset.family;
+    m_hatchAngle = preset.angle;
+    m_hatchSpacing = preset.spacing;
+    m_crossHatching = preset.cross;
+    ++m_paramsRevision;
 }
 
-void HatchingTool::floodFillHatch(const QPoint &startPoint, QImage &image, QPainter &painter)
+void HatchingTool::setPattern(const HatchPattern &pattern)
 {
-    Q_UNUSED(painter);
+    m_hatchType = HatchType(pattern.type);
+    m_hatchFamily = pattern.family;
+    m_hatchAngle = pattern.angle;
+    m_hatchSpacing = qBound(1, pattern.spacing, HatchPattern::MaxSpacing);
+    m_crossHatching = pattern.cross;
+    ++m_paramsRevision;
+}
 
-    if (!image.rect().contains(startPoint))
+void HatchingTool::floodFillHatch(const QPoint &startPoint, QImage &target)
+{
+    CachedRegion *entry = regionAt(startPoint);
+    if (!entry || m_boundaryImage->size() != target.size())
         return;
 
-    QColor targetColor = image.pixelColor(startPoint);
+    const FillRegion &region = entry->region;
+    applyRegions({region}, target);
 
-    if (targetColor == m_penColor)
-        return;
+    const HatchPatternCache::Stats stats = m_patternCache->stats();
+    qCDebug(lcHatching) << "HatchingTool: filled" << region.area() << "pixels, perimeter"
+             << region.perimeter() << "px, pattern cache"
+             << stats.hits << "hits" << stats.misses << "misses";
+}
 
-    QStack<QPoint> stack;
-    stack.push(startPoint);
+int HatchingTool::commitQueue(QImage &target)
+{
+    const QVector<QPoint> seeds = m_queuedSeeds;
+    m_queuedSeeds.clear();
+    return hatchSeeds(seeds, target);
+}
 
-    QImage visited(image.size(), QImage::Format_Mono);
-    visited.fill(0);
+int HatchingTool::hatchSeeds(const QVector<QPoint> &seeds, QImage &target)
+{
+    if (!m_boundaryImage || m_boundaryImage->size() != target.size())
+        return 0;
 
-    QVector<QPoint> areaPixels;
+    const QVector<FillRegion> regions = regionsForSeeds(seeds);
+    applyRegions(regions, target);
 
-    while (!stack.isEmpty()) {
-        QPoint p = stack.pop();
-        int x = p.x();
-        int y = p.y();
+    qCDebug(lcHatching) << "HatchingTool:" << seeds.size() << "seeds ->" << regions.size() << "regions";
+    return regions.size();
+}
 
-        if (!image.rect().contains(x, y))
-            continue;
+int HatchingTool::hatchEnclosedRegions(const QRect &rect, QImage &target)
+{
+    if (!m_boundaryImage || m_boundaryImage->size() != target.size())
+        return 0;
+
+    const QRect area = rect.intersected(m_boundaryImage->rect());
+    if (area.isEmpty() || !area.contains(m_pressPoint))
+        return 0;
+
+    std::vector<std::unique_ptr<FillMask>> masks;
+    FillMask *mask = maskFor(m_pressPoint, masks);
+    if (!mask)
+        return 0;
+
+    // Общая карта обхода: каждая область находится один раз, сколько бы
+    // её пикселей ни попало в прямоугольник
+    ArenaScope scope;
+    const size_t visitedSize = size_t(mask->width()) * size_t(mask->height());
+    uchar *visited = Arena::local().allocateArray<uchar>(visitedSize);
+    std::memset(visited, 0, visitedSize);
+    QVector<FillRegion> regions;
+    for (int y = area.top(); y <= area.bottom(); ++y) {
+        for (int x = area.left(); x <= area.right(); ++x) {
+            if (visited[size_t(y) * size_t(mask->width()) + x] || !mask->row(y)[x])
+                continue;
+            FillRegion region = FillRegion::fromSeed(*mask, QPoint(x, y), visited);
+            if (!region.isEmpty() && area.contains(region.boundingRect()))
+                regions.append(region);
+        }
+    }
+
+    applyRegions(regions, target);
+
+    qCDebug(lcHatching) << "HatchingTool:" << regions.size() << "enclosed regions in" << area;
+    return regions.size();
+}
+
+FillMask *HatchingTool::maskFor(const QPoint &seed, std::vector<std::unique_ptr<FillMask>> &masks)
+{
+    if (!m_boundaryImage || !m_boundaryImage->rect().contains(seed))
+        return nullptr;
+
+    const QColor targetColor = m_boundaryImage->pixelColor(seed);
+    if (targetColor == m_penColor)
+        return nullptr;
+
+    const QRgb target = targetColor.rgba();
+    const QRgb pen = m_penColor.rgba();
+    if (m_fillMask.matches(m_boundaryImage, m_boundaryRevision, target, pen, m_fillMode))
+        return &m_fillMask;
+
+    for (const std::unique_ptr<FillMask> &mask : masks) {
+        if (mask->matches(m_boundaryImage, m_boundaryRevision, target, pen, m_fillMode))
+            return mask.get();
+    }
+
+    masks.push_back(std::make_unique<FillMask>());
+    masks.back()->reset(m_boundaryImage, m_boundaryRevision, target, pen, m_fillMode);
+    return masks.back().get();
+}
 
-        if (visited.pixelIndex(x, y))
+QVector<FillRegion> HatchingTool::regionsForSeeds(const QVector<QPoint> &seeds)
+{
+    // Точки с одной маской (одним цветом под точкой) обходятся по очереди с
+    // общей картой обхода: точка внутри уже найденной области не заливается
+    // повторно, и N щелчков в одной области стоят одной заливки. Разные
+    // маски обрабатываются параллельно
+    struct Group
+    {
+        FillMask *mask = nullptr;
+        QVector<QPoint> seeds;
+        QVector<FillRegion> regions;
+    };
+
+    std::vector<std::unique_ptr<FillMask>> masks;
+    QVector<Group> groups;
+    QVector<FillRegion> regions;
+
+    for (const QPoint &seed : seeds) {
+        bool cached = false;
+        for (const CachedRegion &entry : std::as_const(m_regionCache)) {
+            if (entry.region.contains(seed)) {
+                cached = true;
+                bool known = false;
+                for (const FillRegion &region : std::as_const(regions))
+                    known = known || region.contains(seed);
+                if (!known)
+                    regions.append(entry.region);
+                break;
+            }
+        }
+        if (cached)
             continue;
 
-        if (image.pixelColor(x, y) == targetColor) {
-            visited.setPixel(x, y, 1);
-            areaPixels.append(QPoint(x, y));
+        FillMask *mask = maskFor(seed, masks);
+        if (!mask)
+            continue;
+        auto group = std::find_if(groups.begin(), groups.end(),
+                                  [mask](const Group &g) { return g.mask == mask; });
+        if (group == groups.end()) {
+            groups.append(Group());
+            group = groups.end() - 1;
+            group->mask = mask;
+        }
+        group->seeds.append(seed);
+    }
 
-            stack.push(QPoint(x + 1, y));
-            stack.push(QPoint(x - 1, y));
-            stack.push(QPoint(x, y + 1));
-            stack.push(QPoint(x, y - 1));
+    // У каждой группы своя маска, поэтому ленивые строки маски читаются и
+    // заполняются одним потоком
+    Group *groupData = groups.data();
+    parallelFor(groups.size(), [groupData](int i) {
+        Group &group = groupData[i];
+        FillMask &mask = *group.mask;
+        ArenaScope scope;
+        const size_t visitedSize = size_t(mask.width()) * size_t(mask.height());
+        uchar *visited = Arena::local().allocateArray<uchar>(visitedSize);
+        std::memset(visited, 0, visitedSize);
+        for (const QPoint &seed : std::as_const(group.seeds)) {
+            if (visited[size_t(seed.y()) * size_t(mask.width()) + seed.x()])
+                continue;
+            FillRegion region = FillRegion::fromSeed(mask, seed, visited);
+            if (!region.isEmpty())
+                group.regions.append(region);
+        }
+    });
+
+    // Область из кэша могла найтись и заливкой по другой точке
+    for (const Group &group : std::as_const(groups)) {
+        for (const FillRegion &found : group.regions) {
+            bool duplicate = false;
+            for (const FillRegion &region : std::as_const(regions))
+                duplicate = duplicate || region.contains(found.seed());
+            if (!duplicate)
+                regions.append(found);
         }
     }
+    return regions;
+}
 
-    if (areaPixels.isEmpty())
+void HatchingTool::applyRegions(const QVector<FillRegion> &regions, QImage &target)
+{
+    if (regions.isEmpty())
         return;
 
-    int minX = image.width(), maxX = 0;
-    int minY = image.height(), maxY = 0;
+    QImage tile = m_patternCache->tile(currentPattern());
+    if (tile.format() != target.format())
+        tile = tile.convertToFormat(target.format());
+
+    for (const FillRegion &region : regions)
+        aboutToWrite(region.boundingRect());
+
+    uchar *bits = target.bits();
+    const qsizetype bytesPerLine = target.bytesPerLine();
+    const FillRegion *regionData = regions.constData();
+    const QVector<QVector<int>> passes = writePasses(regions.size(), [regionData](int i) -> const FillRegion & {
+        return regionData[i];
+    });
+    for (const QVector<int> &pass : passes) {
+        const int *indices = pass.constData();
+        parallelFor(pass.size(), [&](int i) {
+            HatchPatternCache::fillSpans(tile, regionData[indices[i]].spans(), bits, bytesPerLine);
+        });
+    }
+
+    const HatchPattern pattern = currentPattern();
+    for (const FillRegion &region : regions) {
+        addDirtyRect(region.boundingRect());
+        m_appliedRegions.append({0, region, pattern});
+    }
+
+    m_lastMeasurement = measure(regions);
+    emit regionsMeasured();
+}
+
+QVector<HatchedRegion> HatchingTool::takeAppliedRegions()
+{
+    QVector<HatchedRegion> regions;
+    regions.swap(m_appliedRegions);
+    return regions;
+}
 
-    for (const QPoint &p : areaPixels) {
-        minX = qMin(minX, p.x());
-        maxX = qMax(maxX, p.x());
-        minY = qMin(minY, p.y());
-        maxY = qMax(maxY, p.y());
+QRect HatchingTool::renderRegions(const QVector<HatchedRegion> &regions, QImage &target)
+{
+    // Плитки берутся из кэша до параллельной части
+    QVector<QImage> tiles;
+    tiles.reserve(regions.size());
+    QRect changed;
+    for (const HatchedRegion &entry : regions) {
+        QImage tile = m_patternCache->tile(entry.pattern);
+        if (tile.format() != target.format())
+            tile = tile.convertToFormat(target.format());
+        tiles.append(tile);
+        changed |= entry.region.boundingRect();
     }
 
-    int width = maxX - minX + 1;
-    int height = maxY - minY + 1;
+    // Плитка пишется целиком, с прозрачными пикселями, поэтому прежняя
+    // штриховка области стирается тем же проходом
+    uchar *bits = target.bits();
+    const qsizetype bytesPerLine = target.bytesPerLine();
+    const HatchedRegion *regionData = regions.constData();
+    const QImage *tileData = tiles.constData();
+    const QVector<QVector<int>> passes = writePasses(regions.size(), [regionData](int i) -> const FillRegion & {
+        return regionData[i].region;
+    });
+    for (const QVector<int> &pass : passes) {
+        const int *indices = pass.constData();
+        parallelFor(pass.size(), [&](int i) {
+            HatchPatternCache::fillSpans(tileData[indices[i]], regionData[indices[i]].region.spans(),
+                                         bits, bytesPerLine);
+        });
+    }
+    return changed;
+}
 
-    QImage hatchImage(width, height, QImage::Format_ARGB32);
-    hatchImage.fill(Qt::transparent);
+HatchingTool::Measurement HatchingTool::measure(const QVector<FillRegion> &regions) const
+{
+    Measurement result;
+    result.millimetresPerPixel = 25.4 / m_measurementDpi * m_measurementScale;
+
+    // Общий центр тяжести — среднее центров, взвешенное по площади
+    QPointF weighted;
+    for (const FillRegion &region : regions) {
+        ++result.regions;
+        result.area += region.area();
+        result.perimeter += region.perimeter();
+        result.bounds |= region.boundingRect();
+        weighted += region.centroid() * qreal(region.area());
+    }
+    if (result.area > 0)
+        result.centroid = weighted / qreal(result.area);
+    return result;
+}
 
-    drawHatchOnImage(hatchImage, width, height);
+void HatchingTool::setMeasurementScale(qreal dpi, qreal scale)
+{
+    if (dpi <= 0 || scale <= 0)
+        return;
+    m_measurementDpi = dpi;
+    m_measurementScale = scale;
+    m_lastMeasurement.millimetresPerPixel = 25.4 / dpi * scale;
+}
 
-    for (const QPoint &p : areaPixels) {
-        int localX = p.x() - minX;
-        int localY = p.y() - minY;
+HatchingTool::CachedRegion *HatchingTool::regionAt(const QPoint &point)
+{
+    if (!m_boundaryImage || !m_boundaryImage->rect().contains(point))
+        return nullptr;
 
-        if (localX >= 0 && localX < width && localY >= 0 && localY < height) {
-            QColor hatchColor = hatchImage.pixelColor(localX, localY);
-            if (hatchColor.alpha() > 0) {
-                image.setPixelColor(p, hatchColor);
-            }
+    for (int i = 0; i < m_regionCache.size(); ++i) {
+        if (m_regionCache[i].region.contains(point)) {
+            m_regionCache.move(i, 0);
+            return &m_regionCache.first();
         }
     }
 
-    qDebug() << "HatchingTool: filled" << areaPixels.size() << "pixels";
+    QColor targetColor = m_boundaryImage->pixelColor(point);
+
+    if (targetColor == m_penColor)
+        return nullptr;
+
+    const QRgb target = targetColor.rgba();
+    const QRgb pen = m_penColor.rgba();
+    if (!m_fillMask.matches(m_boundaryImage, m_boundaryRevision, target, pen, m_fillMode))
+        m_fillMask.reset(m_boundaryImage, m_boundaryRevision, target, pen, m_fillMode);
+
+    CachedRegion entry;
+    entry.region = FillRegion::fromSeed(m_fillMask, point);
+    if (entry.region.isEmpty())
+        return nullptr;
+
+    m_regionCache.prepend(entry);
+    while (m_regionCache.size() > MaxCachedRegions)
+        m_regionCache.removeLast();
+    return &m_regionCache.first();
 }
 
-void HatchingTool::drawHatchOnImage(QImage &hatchImage, int width, int height)
+void HatchingTool::renderRegion(CachedRegion &entry)
 {
-    QPainter painter(&hatchImage);
-    painter.setPen(QPen(m_penColor, m_penWidth));
+    if (entry.paramsRevision == m_paramsRevision)
+        return;
 
-    int diagonal = static_cast<int>(std::sqrt(width * width + height * height));
+    const FillRegion &region = entry.region;
+    const QRect bounds = region.boundingRect();
 
-    if (m_crossHatching) {
-        double angle1Rad = qDegreesToRadians(static_cast<double>(m_hatchAngle));
-        double cosAngle1 = std::cos(angle1Rad);
-        double sinAngle1 = std::sin(angle1Rad);
+    // Штриховка, обрезанная по области, и полупрозрачная подсветка под ней
+    entry.overlay = QImage(bounds.size(), QImage::Format_ARGB32_Premultiplied);
+    entry.overlay.fill(Qt::transparent);
+    HatchPatternCache::fillSpans(m_patternCache->tile(currentPattern()), region.spans(),
+                                 entry.overlay, bounds.topLeft());
 
-        double angle2Rad = qDegreesToRadians(static_cast<double>(-m_hatchAngle));
-        double cosAngle2 = std::cos(angle2Rad);
-        double sinAngle2 = std::sin(angle2Rad);
+    QColor highlight = m_penColor;
+    highlight.setAlpha(48);
+    const QRgb highlightRgb = qPremultiply(highlight.rgba());
 
-        for (int i = -diagonal; i < diagonal; i += m_hatchSpacing) {
-            QPointF p1, p2;
-            if (std::abs(sinAngle1) > std::abs(cosAngle1)) {
-                p1 = QPointF(i / sinAngle1, 0);
-                p2 = QPointF((i - height * cosAngle1) / sinAngle1, height);
-            } else {
-                p1 = QPointF(0, i / cosAngle1);
-                p2 = QPointF(width, (i - width * sinAngle1) / cosAngle1);
-            }
-            painter.drawLine(p1, p2);
+    for (const FillSpan &span : region.spans()) {
+        QRgb *overlay = reinterpret_cast<QRgb *>(entry.overlay.scanLine(span.y - bounds.top()));
+        for (int x = span.x1 - bounds.left(); x <= span.x2 - bounds.left(); ++x) {
+            if (qAlpha(overlay[x]) == 0)
+                overlay[x] = highlightRgb;
         }
+    }
 
-        for (int i = -diagonal; i < diagonal; i += m_hatchSpacing) {
-            QPointF p1, p2;
-            if (std::abs(sinAngle2) > std::abs(cosAngle2)) {
-                p1 = QPointF(i / sinAngle2, 0);
-                p2 = QPointF((i - height * cosAngle2) / sinAngle2, height);
-            } else {
-                p1 = QPointF(0, i / cosAngle2);
-                p2 = QPointF(width, (i - width * sinAngle2) / cosAngle2);
-            }
-            painter.drawLine(p1, p2);
-        }
-    } else {
-        double angleRad = qDegreesToRadians(static_cast<double>(m_hatchAngle));
-        double cosAngle = std::cos(angleRad);
-        double sinAngle = std::sin(angleRad);
-
-        for (int i = -diagonal; i < diagonal; i += m_hatchSpacing) {
-            QPointF p1, p2;
-            if (std::abs(sinAngle) > std::abs(cosAngle)) {
-                p1 = QPointF(i / sinAngle, 0);
-                p2 = QPointF((i - height * cosAngle) / sinAngle, height);
-            } else {
-                p1 = QPointF(0, i / cosAngle);
-                p2 = QPointF(width, (i - width * sinAngle) / cosAngle);
-            }
-            painter.drawLine(p1, p2);
-        }
+    entry.paramsRevision = m_paramsRevision;
+}
+
+void HatchingTool::setBoundaryImage(const QImage *image, quint64 revision)
+{
+    if (image != m_boundaryImage || revision != m_boundaryRevision)
+        m_regionCache.clear();
+    m_boundaryImage = image;
+    m_boundaryRevision = revision;
+}
+
+QRect HatchingTool::updatePreview(const QPoint &point)
+{
+    // Курсор остался в той же области — кадр не меняется
+    if (m_previewRect.isValid() && !m_regionCache.isEmpty()) {
+        const CachedRegion &current = m_regionCache.first();
+        if (current.region.boundingRect() == m_previewRect
+            && current.paramsRevision == m_paramsRevision
+            && current.region.contains(point))
+            return QRect();
     }
+
+    QRect changed = clearPreview();
+
+    CachedRegion *entry = regionAt(point);
+    if (!entry)
+        return changed;
+
+    renderRegion(*entry);
+    m_previewImage = entry->overlay;
+    m_previewRect = entry->region.boundingRect();
+    return changed | m_previewRect;
+}
+
+QRect HatchingTool::clearPreview()
+{
+    const QRect changed = m_previewRect;
+    m_previewImage = QImage();
+    m_previewRect = QRect();
+    return changed;
+}
+
+void HatchingTool::setFillMode(FillMask::Mode mode)
+{
+    if (m_fillMode == mode)
+        return;
+    m_fillMode = mode;
+    m_regionCache.clear();
+    m_previewImage = QImage();
+    m_previewRect = QRect();
+}
+
+qint64 HatchingTool::regionCacheBytes() const
+{
+    qint64 bytes = 0;
+    for (const CachedRegion &entry : m_regionCache)
+        bytes += entry.overlay.sizeInBytes() + qint64(entry.region.spans().capacity()) * qint64(sizeof(FillSpan));
+    return bytes;
+}
+
+qint64 HatchingTool::dropRegionCache()
+{
+    const qint64 freed = regionCacheBytes();
+    m_regionCache.clear();
+    return freed;
+}
+
+qint64 HatchingTool::dropPatternCache()
+{
+    const qint64 freed = m_patternCache->stats().bytes;
+    m_patternCache->clear();
+    return freed;
+}
+
+HatchPattern HatchingTool::currentPattern() const
+{
+    HatchPattern pattern;
+    pattern.type = m_hatchType;
+    pattern.family = m_hatchFamily;
+    pattern.angle = m_hatchAngle;
+    pattern.spacing = m_hatchSpacing;
+    pattern.cross = m_crossHatching;
+    pattern.penWidth = m_penWidth;
+    pattern.color = m_penColor.rgba();
+    return pattern;
+}
+
+void HatchingTool::setPenColor(const QColor &color)
+{
+    Tool::setPenColor(color);
+    ++m_paramsRevision;
+}
+
+void HatchingTool::setPenWidth(int width)
+{
+    // Толщина входит в ключ плитки, см. HatchPattern::MaxPenWidth
+    Tool::setPenWidth(qBound(1, width, HatchPattern::MaxPenWidth));
+    ++m_paramsRevision;
 }
@@ -2,10 +2,18 @@
 #define HATCHINGTOOL_H
 
 #include "tool.h"
+#include "fillmask.h"
+#include "fillregion.h"
+#include "hatchpatterncache.h"
 #include <QImage>
+#include <QList>
 #include <QPoint>
+#include <QPointF>
 #include <QRect>
+#include <QSizeF>
 #include <QVector>
+#include <memory>
+#include <vector>
 
 class HatchingTool : public Tool
 {
@@ -23,37 +31,160 @@ public:
         Soil
     };
 
+    // Измерения заштрихованных за одну операцию областей. Величины в
+    // пикселях набираются во время заливки (см. FillRegion), перевод в
+    // миллиметры натуры — по масштабу из setMeasurementScale
+    struct Measurement
+    {
+        int regions = 0;
+        qint64 area = 0;
+        qint64 perimeter = 0;
+        QPointF centroid;
+        QRect bounds;
+        qreal millimetresPerPixel = 25.4 / 96;
+
+        qreal areaMm2() const { return area * millimetresPerPixel * millimetresPerPixel; }
+        qreal perimeterMm() const { return perimeter * millimetresPerPixel; }
+        QPointF centroidMm() const { return centroid * millimetresPerPixel; }
+        QSizeF boundsMm() const { return QSizeF(bounds.size()) * millimetresPerPixel; }
+    };
+
     explicit HatchingTool(QObject *parent = nullptr);
 
     void onMousePress(QMouseEvent *event, QPainter &painter, const QPoint &lastPoint) override;
     void onMouseMove(QMouseEvent *event, QPainter &painter, const QPoint &lastPoint) override;
     void onMouseRelease(QMouseEvent *event, QPainter &painter, const QPoint &lastPoint) override;
 
-    void setHatchAngle(int angle) { m_hatchAngle = angle; }
-    void setHatchSpacing(int spacing) { m_hatchSpacing = spacing; }
-    void setCrossHatching(bool cross) { m_crossHatching = cross; }
+    LayerStack::LayerId targetLayer() const override { return LayerStack::HatchLayer; }
+
+    // Изображение с контурами, по которому ищется замкнутая область;
+    // revision меняется при каждом изменении контуров
+    void setBoundaryImage(const QImage *image, quint64 revision);
+
+    // Предпросмотр штриховки области под курсором. Возвращают прямоугольник,
+    // который нужно перерисовать
+    QRect updatePreview(const QPoint &point);
+    QRect clearPreview();
+    const QImage &previewImage() const { return m_previewImage; }
+    QRect previewRect() const { return m_previewRect; }
+
+    // Пакетная штриховка. Shift+клик ставит точку в очередь, обычный клик
+    // добавляет последнюю точку и штрихует всю очередь одной операцией;
+    // Ctrl+протяжка штрихует все замкнутые области внутри прямоугольника.
+    // Точки одной области заливаются один раз, области заполняются
+    // параллельно; методы возвращают их число
+    const QVector<QPoint> &queuedSeeds() const { return m_queuedSeeds; }
+    QRect selectionRect() const { return m_selectionRect; }
+    void clearQueue() { m_queuedSeeds.clear(); }
+    int commitQueue(QImage &target);
+    int hatchSeeds(const QVector<QPoint> &seeds, QImage &target);
+    int hatchEnclosedRegions(const QRect &rect, QImage &target);
+
+    void setPenColor(const QColor &color) override;
+    void setPenWidth(int width) override;
+
+    void setHatchAngle(int angle) { m_hatchAngle = angle; ++m_paramsRevision; }
+    void setHatchSpacing(int spacing) { m_hatchSpacing = qBound(1, spacing, HatchPattern::MaxSpacing); ++m_paramsRevision; }
+    void setCrossHatching(bool cross) { m_crossHatching = cross; ++m_paramsRevision; }
     void setHatchType(HatchType type);
+    // Материал, семейство, угол, шаг и перекрёстность из готового рисунка,
+    // без подстановки пресета материала; перо не меняется
+    void setPattern(const HatchPattern &pattern);
+    // Заливать ли сглаженные края линий вместе с областью
+    void setFillMode(FillMask::Mode mode);
 
     int getHatchAngle() const { return m_hatchAngle; }
     int getHatchSpacing() const { return m_hatchSpacing; }
     bool isCrossHatching() const { return m_crossHatching; }
     HatchType getHatchType() const { return m_hatchType; }
+    FillMask::Mode fillMode() const { return m_fillMode; }
+
+    // Разрешение изображения и масштаб чертежа 1:scale
+    void setMeasurementScale(qreal dpi, qreal scale);
+    qreal measurementDpi() const { return m_measurementDpi; }
+    qreal measurementScale() const { return m_measurementScale; }
+    const Measurement &lastMeasurement() const { return m_lastMeasurement; }
+    // Суммарные площадь и периметр, общий центр тяжести и охватывающий прямоугольник
+    Measurement measure(const QVector<FillRegion> &regions) const;
+
+    HatchPattern currentPattern() const;
+
+    // Области, заштрихованные с прошлого вызова, с параметрами штриховки
+    QVector<HatchedRegion> takeAppliedRegions();
+    // Перерисовывает сохранённые области по их отрезкам и параметрам, без
+    // заливки; время пропорционально площади областей. Возвращает
+    // изменённый прямоугольник
+    QRect renderRegions(const QVector<HatchedRegion> &regions, QImage &target);
+    HatchPatternCache::Stats patternCacheStats() const { return m_patternCache->stats(); }
+    // Кэш плиток можно разделить между документами: плитки зависят только
+    // от параметров рисунка
+    void setPatternCache(const std::shared_ptr<HatchPatternCache> &cache) { m_patternCache = cache; }
+    const std::shared_ptr<HatchPatternCache> &patternCache() const { return m_patternCache; }
+
+    // Память кэшей инструмента и их освобождение (см. MemoryAccountant);
+    // drop-методы возвращают число освобождённых байт
+    qint64 regionCacheBytes() const;
+    qint64 fillMaskBytes() const { return m_fillMask.bytes(); }
+    qint64 dropRegionCache();
+    qint64 dropPatternCache();
+    qint64 dropFillMask() { return m_fillMask.release(); }
+
+signals:
+    void regionsMeasured();
 
 private:
-    // Основной метод заливки области штриховкой (точная копия логики из ScribbleArea)
-    void floodFillHatch(const QPoint &startPoint, QImage &image, QPainter &painter);
+    static const int MaxCachedRegions = 8;
 
-    // Рисование штриховки на отдельном изображении (как в drawCrossHatching и hatchArea)
-    void drawHatchOnImage(QImage &hatchImage, int width, int height);
+    // Найденная область вместе с её подсветкой для предпросмотра
+    struct CachedRegion
+    {
+        FillRegion region;
+        QImage overlay;
+        int paramsRevision = -1;
+    };
+
+    // Основной метод заливки области штриховкой: область ищется по контурам,
+    // штриховка пишется в слой штриховки
+    void floodFillHatch(const QPoint &startPoint, QImage &target);
+
+    // Область под точкой: из кэша или новой заливкой
+    CachedRegion *regionAt(const QPoint &point);
+    void renderRegion(CachedRegion &entry);
+
+    // Маска для цвета под точкой seed; при необходимости создаётся в masks
+    FillMask *maskFor(const QPoint &seed, std::vector<std::unique_ptr<FillMask>> &masks);
+    // Области для точек без повторов: точки одной области дают одну область
+    QVector<FillRegion> regionsForSeeds(const QVector<QPoint> &seeds);
+    void applyRegions(const QVector<FillRegion> &regions, QImage &target);
 
     // Параметры штриховки
     int m_hatchAngle = 45;
     int m_hatchSpacing = 10;
     bool m_crossHatching = false;
     HatchType m_hatchType = Metal;
+    HatchKernels::Family m_hatchFamily = HatchKernels::Parallel;
+    FillMask::Mode m_fillMode = FillMask::AntialiasAware;
+    qreal m_measurementDpi = 96;
+    qreal m_measurementScale = 1;
+    Measurement m_lastMeasurement;
+    QVector<HatchedRegion> m_appliedRegions;
 
     // Состояние инструмента
     bool m_isDrawing = false;
+    bool m_selecting = false;
+    QPoint m_pressPoint;
+    QRect m_selectionRect;
+    QVector<QPoint> m_queuedSeeds;
+    const QImage *m_boundaryImage = nullptr;
+    quint64 m_boundaryRevision = 0;
+    int m_paramsRevision = 0;
+
+    // Последние найденные области, самая свежая первой
+    QList<CachedRegion> m_regionCache;
+    FillMask m_fillMask;
+    std::shared_ptr<HatchPatternCache> m_patternCache = std::make_shared<HatchPatternCache>();
+    QImage m_previewImage;
+    QRect m_previewRect;
 };
 
 #endif // HATCHINGTOOL_H
@@ -0,0 +1,231 @@
+#ifndef HATCHKERNELS_H
+#define HATCHKERNELS_H
+
+#include <QImage>
+#include <QRgb>
+#include <QtMath>
+#include <cmath>
+#include <cstdlib>
+#include <numeric>
+
+// Ядра рисунков штриховки. Каждое семейство — отдельная специализация
+// шаблона Kernel, параметры семейств берутся из таблицы Families. Выбор
+// ядра происходит один раз на плитку, внутренний цикл по пикселям
+// инстанцируется для каждого семейства отдельно и не ветвится по типу.
+namespace HatchKernels {
+
+enum Family {
+    Parallel,
+    Cross,
+    WoodGrain,
+    SoilDashes,
+    GlassDots,
+    ConcreteAggregate,
+    FamilyCount
+};
+
+// Параметры семейства. Периоды заданы в шагах штриховки
+struct FamilyParams
+{
+    const char *name;
+    // Период поперёк линий, в линиях
+    int linesPerPeriod;
+    // Период вдоль линий, в полушагах; 0 — рисунок вдоль линий однороден
+    int alongHalfSteps;
+    // Доля штриха в периоде вдоль линии
+    int dashPercent;
+    // Размах волны древесных волокон, в процентах шага
+    int amplitudePercent;
+};
+
+constexpr FamilyParams Families[FamilyCount] = {
+    {"parallel", 1, 0, 100, 0},
+    {"cross", 1, 0, 100, 0},
+    {"wood", 1, 12, 100, 30},
+    {"soil", 2, 4, 60, 0},
+    {"glass", 1, 1, 0, 0},
+    {"concrete", 3, 4, 0, 0},
+};
+
+// Решётка линий в удвоенных координатах: центр пикселя x + 0.5 даёт целое
+// u = 2x + 1. Поперёк линий s = a*u + b*v, вдоль линий t = -b*u + a*v;
+// соседние линии отстоят на 2k по s. Все длины — в тех же единицах
+struct Lattice
+{
+    int a = 0;
+    int b = 1;
+    int k = 1;
+    qreal halfWidth = 1;
+    int periodS = 2;
+    int periodT = 0;
+    FamilyParams params = Families[Parallel];
+};
+
+// Остаток в [0, period)
+inline int wrap(int value, int period)
+{
+    const int r = value % period;
+    return r < 0 ? r + period : r;
+}
+
+// Остаток в [-period / 2, period - period / 2)
+inline int centered(int value, int period)
+{
+    const int r = wrap(value + period / 2, period);
+    return r - period / 2;
+}
+
+inline bool onLine(const Lattice &l, int s)
+{
+    const int r = centered(s, 2 * l.k);
+    return -l.halfWidth <= r && r < l.halfWidth;
+}
+
+// Детерминированный хеш ячейки для рисунка заполнителя бетона
+inline quint32 cellHash(int i, int j)
+{
+    quint32 h = quint32(i) * 0x9e3779b1u ^ quint32(j) * 0x85ebca77u;
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    return h;
+}
+
+template <Family F>
+struct Kernel;
+
+template <>
+struct Kernel<Parallel>
+{
+    static bool covers(const Lattice &l, int u, int v)
+    {
+        return onLine(l, l.a * u + l.b * v);
+    }
+};
+
+// Второе семейство зеркально первому относительно вертикали
+template <>
+struct Kernel<Cross>
+{
+    static bool covers(const Lattice &l, int u, int v)
+    {
+        return onLine(l, l.a * u + l.b * v) || onLine(l, -l.a * u + l.b * v);
+    }
+};
+
+// Волокна древесины: линии, смещённые поперёк синусоидой вдоль линии
+template <>
+struct Kernel<WoodGrain>
+{
+    static bool covers(const Lattice &l, int u, int v)
+    {
+        const int s = l.a * u + l.b * v;
+        const int t = -l.b * u + l.a * v;
+        const qreal amplitude = l.params.amplitudePercent * 2 * l.k / 100.0;
+        const qreal phase = 2 * M_PI * wrap(t, l.periodT) / l.periodT;
+        return onLine(l, s - qRound(amplitude * std::sin(phase)));
+    }
+};
+
+// Грунт: короткие штрихи, соседние ряды сдвинуты на полпериода
+template <>
+struct Kernel<SoilDashes>
+{
+    static bool covers(const Lattice &l, int u, int v)
+    {
+        const int s = l.a * u + l.b * v;
+        if (!onLine(l, s))
+            return false;
+        const int t = -l.b * u + l.a * v;
+        const int row = wrap(s + l.k, l.periodS) / (2 * l.k);
+        const int along = wrap(t + row * (l.periodT / 2), l.periodT);
+        return along * 100 < l.params.dashPercent * l.periodT;
+    }
+};
+
+// Стекло: точки толщиной в перо вдоль линий
+template <>
+struct Kernel<GlassDots>
+{
+    static bool covers(const Lattice &l, int u, int v)
+    {
+        if (!onLine(l, l.a * u + l.b * v))
+            return false;
+        const int r = centered(-l.b * u + l.a * v, l.periodT);
+        return -l.halfWidth <= r && r < l.halfWidth;
+    }
+};
+
+// Бетон: линии и зёрна заполнителя между ними; размер и положение зерна
+// в ячейке задаются хешем, поэтому рисунок неоднороден, но периодичен
+template <>
+struct Kernel<ConcreteAggregate>
+{
+    static bool covers(const Lattice &l, int u, int v)
+    {
+        const int s = l.a * u + l.b * v;
+        if (onLine(l, s))
+            return true;
+
+        const int t = -l.b * u + l.a * v;
+        const int sInPeriod = wrap(s, l.periodS);
+        const int tInPeriod = wrap(t, l.periodT);
+        const int cell = sInPeriod / (2 * l.k);
+        const quint32 h = cellHash(cell, 0);
+
+        // Центр зерна посередине между линиями, вдоль линии — по хешу
+        const int ds = sInPeriod - (cell * 2 * l.k + l.k);
+        const int dt = centered(tInPeriod - int(h % quint32(l.periodT)), l.periodT);
+        const qreal radius = l.halfWidth * (1.5 + (h >> 8) % 3 * 0.5);
+        return qreal(ds) * ds + qreal(dt) * dt < radius * radius;
+    }
+};
+
+// Наименьшая плитка, которая при сдвиге на свою ширину или высоту
+// переводит рисунок в себя
+inline QSize tileSize(const Lattice &l)
+{
+    auto period = [](int step, int modulus) {
+        return modulus / std::gcd(2 * std::abs(step), modulus);
+    };
+    auto lcm = [](int x, int y) { return x / std::gcd(x, y) * y; };
+
+    int width = period(l.a, l.periodS);
+    int height = period(l.b, l.periodS);
+    if (l.periodT > 0) {
+        width = lcm(width, period(l.b, l.periodT));
+        height = lcm(height, period(l.a, l.periodT));
+    }
+    return QSize(width, height);
+}
+
+template <Family F>
+void renderTile(QImage &tile, const Lattice &lattice, QRgb color)
+{
+    for (int y = 0; y < tile.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(tile.scanLine(y));
+        const int v = 2 * y + 1;
+        for (int x = 0; x < tile.width(); ++x) {
+            if (Kernel<F>::covers(lattice, 2 * x + 1, v))
+                line[x] = color;
+        }
+    }
+}
+
+// Единственное ветвление по семейству — на плитку, а не на пиксель
+inline void renderTile(Family family, QImage &tile, const Lattice &lattice, QRgb color)
+{
+    switch (family) {
+    case Parallel: renderTile<Parallel>(tile, lattice, color); break;
+    case Cross: renderTile<Cross>(tile, lattice, color); break;
+    case WoodGrain: renderTile<WoodGrain>(tile, lattice, color); break;
+    case SoilDashes: renderTile<SoilDashes>(tile, lattice, color); break;
+    case GlassDots: renderTile<GlassDots>(tile, lattice, color); break;
+    case ConcreteAggregate: renderTile<ConcreteAggregate>(tile, lattice, color); break;
+    case FamilyCount: break;
+    }
+}
+
+} // namespace HatchKernels
+
+#endif // HATCHKERNELS_H
@@ -0,0 +1,142 @@
+#include "hatchpatterncache.h"
+#include <QtMath>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace {
+
+// Наибольшая площадь плитки, в пикселях (1 МиБ в ARGB32)
+const int MaxTileArea = 512 * 512;
+// Пределы компонент нормали: от точного угла к грубому
+const int NormalLimits[] = {8, 4, 2, 1};
+
+// Целочисленная нормаль (a, b) с |a|, |b| <= limit, ближайшая по углу к (sin, cos)
+void latticeNormal(int angle, int limit, int &a, int &b)
+{
+    const qreal radians = qDegreesToRadians(static_cast<qreal>(angle));
+    const qreal target = std::atan2(std::sin(radians), std::cos(radians));
+
+    qreal bestError = 10;
+    for (int i = -limit; i <= limit; ++i) {
+        for (int j = -limit; j <= limit; ++j) {
+            if ((i == 0 && j == 0) || std::gcd(i, j) != 1)
+                continue;
+            qreal error = std::abs(std::atan2(qreal(i), qreal(j)) - target);
+            error = qMin(error, 2 * M_PI - error);
+            if (error < bestError - 1e-9) {
+                bestError = error;
+                a = i;
+                b = j;
+            }
+        }
+    }
+}
+
+} // namespace
+
+quint64 HatchPattern::key() const
+{
+    // Поля не обрезаются: разные рисунки не должны получать один ключ
+    Q_ASSERT(type >= 0 && type < 16);
+    Q_ASSERT(spacing >= 1 && spacing <= MaxSpacing);
+    Q_ASSERT(penWidth >= 1 && penWidth <= MaxPenWidth);
+    quint64 result = quint64(type & 0xf);
+    result = (result << 3) | quint64(family & 0x7);
+    result = (result << 9) | quint64(((angle % 360) + 360) % 360);
+    result = (result << 6) | quint64(spacing & 0x3f);
+    result = (result << 1) | quint64(cross ? 1 : 0);
+    result = (result << 6) | quint64(penWidth & 0x3f);
+    result = (result << 32) | quint64(color);
+    return result;
+}
+
+const QImage &HatchPatternCache::tile(const HatchPattern &pattern)
+{
+    const quint64 key = pattern.key();
+    auto it = m_tiles.find(key);
+    if (it != m_tiles.end()) {
+        ++m_hits;
+        return it.value();
+    }
+    ++m_misses;
+
+    HatchKernels::Family family = pattern.family;
+    if (family == HatchKernels::Parallel && pattern.cross)
+        family = HatchKernels::Cross;
+
+    // Период рисунка с периодом вдоль линий растёт с компонентами нормали:
+    // при нормали (7, 8) и шаге 50 плитка дерева — 1596×3192. Если плитка
+    // больше MaxTileArea, угол приближается грубее, пока она не уложится.
+    // При нормали с компонентами не больше 1 и шаге до MaxSpacing плитка
+    // укладывается всегда: наибольшая — 426×426 у дерева под 45°, предел
+    // превышается только с шага 182
+    HatchKernels::Lattice lattice;
+    QSize size;
+    for (int limit : NormalLimits) {
+        // Линии семейства: a*x + b*y = m*k; расстояние между ними k / |n|
+        latticeNormal(pattern.angle, limit, lattice.a, lattice.b);
+        const qreal norm = std::sqrt(qreal(lattice.a * lattice.a + lattice.b * lattice.b));
+        lattice.k = qMax(1, qRound(pattern.spacing * norm));
+        // Центр пикселя закрашивается, если он ближе к линии, чем полтолщины пера
+        lattice.halfWidth = qMax(1, pattern.penWidth) * norm;
+        lattice.params = HatchKernels::Families[family];
+        lattice.periodS = 2 * lattice.k * lattice.params.linesPerPeriod;
+        lattice.periodT = lattice.k * lattice.params.alongHalfSteps;
+
+        // Минимальный период: сдвиг (W, 0) и (0, H) переводит рисунок в себя
+        size = HatchKernels::tileSize(lattice);
+        if (qint64(size.width()) * size.height() <= MaxTileArea)
+            break;
+    }
+    Q_ASSERT(qint64(size.width()) * size.height() <= MaxTileArea);
+
+    // Плитка в формате слоя штриховки: копируется в него без преобразования
+    QImage tile(size, QImage::Format_ARGB32_Premultiplied);
+    tile.fill(Qt::transparent);
+    HatchKernels::renderTile(family, tile, lattice, qPremultiply(pattern.color));
+
+    return m_tiles.insert(key, tile).value();
+}
+
+void HatchPatternCache::fillSpans(const QImage &tile, const QVector<FillSpan> &spans,
+                                  QImage &target, const QPoint &origin)
+{
+    fillSpans(tile, spans, target.bits(), target.bytesPerLine(), origin);
+}
+
+void HatchPatternCache::fillSpans(const QImage &tile, const QVector<FillSpan> &spans,
+                                  uchar *bits, qsizetype bytesPerLine, const QPoint &origin)
+{
+    const int tileWidth = tile.width();
+    const int tileHeight = tile.height();
+
+    for (const FillSpan &span : spans) {
+        const QRgb *src = reinterpret_cast<const QRgb *>(tile.constScanLine(span.y % tileHeight));
+        QRgb *dst = reinterpret_cast<QRgb *>(bits + (span.y - origin.y()) * bytesPerLine) - origin.x();
+
+        int x = span.x1;
+        while (x <= span.x2) {
+            const int offset = x % tileWidth;
+            const int count = qMin(tileWidth - offset, span.x2 - x + 1);
+            std::memcpy(dst + x, src + offset, size_t(count) * sizeof(QRgb));
+            x += count;
+        }
+    }
+}
+
+void HatchPatternCache::clear()
+{
+    m_tiles.clear();
+}
+
+HatchPatternCache::Stats HatchPatternCache::stats() const
+{
+    Stats result;
+    result.hits = m_hits;
+    result.misses = m_misses;
+    result.tiles = m_tiles.size();
+    for (const QImage &tile : m_tiles)
+        result.bytes += tile.sizeInBytes();
+    return result;
+}
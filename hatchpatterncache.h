@@ -0,0 +1,74 @@
+#ifndef HATCHPATTERNCACHE_H
+#define HATCHPATTERNCACHE_H
+
+#include "fillregion.h"
+#include "hatchkernels.h"
+#include <QHash>
+#include <QImage>
+#include <QPoint>
+#include <QRgb>
+
+// Параметры штриховки, однозначно задающие её рисунок
+struct HatchPattern
+{
+    // Пределы шага и толщины, как в диалогах. HatchingTool ограничивает ими
+    // параметры: в этих пределах ключ точен, а плитка укладывается в
+    // наибольшую площадь кэша
+    static const int MaxSpacing = 50;
+    static const int MaxPenWidth = 50;
+
+    int type = 0;
+    HatchKernels::Family family = HatchKernels::Parallel;
+    int angle = 45;
+    int spacing = 10;
+    bool cross = false;
+    int penWidth = 1;
+    QRgb color = 0xff0000ff;
+
+    quint64 key() const;
+};
+
+// Заштрихованная область документа: геометрия из заливки и параметры, по
+// которым её можно перерисовать без повторной заливки
+struct HatchedRegion
+{
+    int id = 0;
+    FillRegion region;
+    HatchPattern pattern;
+};
+
+// Кэш периодических плиток штриховки. Для каждого набора параметров плитка
+// минимального периода строится один раз, а области заливаются её
+// копированием по строкам. Фаза рисунка привязана к началу листа, поэтому
+// штриховка соседних областей совпадает.
+class HatchPatternCache
+{
+public:
+    struct Stats
+    {
+        int hits = 0;
+        int misses = 0;
+        int tiles = 0;
+        qint64 bytes = 0;
+    };
+
+    const QImage &tile(const HatchPattern &pattern);
+
+    // Копирует плитку в отрезки области; пиксель (x, y) листа попадает
+    // в target по координатам (x, y) - origin
+    static void fillSpans(const QImage &tile, const QVector<FillSpan> &spans,
+                          QImage &target, const QPoint &origin = QPoint());
+    // Вариант для нескольких потоков: target.bits() берётся заранее в одном потоке
+    static void fillSpans(const QImage &tile, const QVector<FillSpan> &spans,
+                          uchar *bits, qsizetype bytesPerLine, const QPoint &origin = QPoint());
+
+    void clear();
+    Stats stats() const;
+
+private:
+    QHash<quint64, QImage> m_tiles;
+    int m_hits = 0;
+    int m_misses = 0;
+};
+
+#endif // HATCHPATTERNCACHE_H
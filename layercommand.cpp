@@ -0,0 +1,60 @@
+#include "layercommand.h"
+#include <QPainter>
+
+LayerEditCommand::LayerEditCommand(LayerStack *layers, LayerStack::LayerId id, const QRect &rect,
+                                   const QImage &before, const QImage &after, const QString &text)
+    : QUndoCommand(text)
+    , m_layers(layers)
+    , m_id(id)
+    , m_rect(rect)
+    , m_before(before)
+    , m_after(after)
+{
+}
+
+void LayerEditCommand::undo()
+{
+    restore(m_before);
+    m_applied = false;
+}
+
+void LayerEditCommand::redo()
+{
+    if (m_applied)
+        return;
+    restore(m_after);
+    m_applied = true;
+}
+
+void LayerEditCommand::restore(const QImage &pixels)
+{
+    QPainter painter(&m_layers->image(m_id));
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.drawImage(m_rect.topLeft(), pixels);
+    painter.end();
+
+    m_layers->markDirty(m_id, m_rect);
+}
+
+HatchEditCommand::HatchEditCommand(LayerStack *layers, const QRect &rect, const QImage &before,
+                                   const QImage &after, QVector<HatchedRegion> *regions,
+                                   const QVector<HatchedRegion> &regionsBefore,
+                                   const QVector<HatchedRegion> &regionsAfter, const QString &text)
+    : LayerEditCommand(layers, LayerStack::HatchLayer, rect, before, after, text)
+    , m_regions(regions)
+    , m_regionsBefore(regionsBefore)
+    , m_regionsAfter(regionsAfter)
+{
+}
+
+void HatchEditCommand::undo()
+{
+    LayerEditCommand::undo();
+    *m_regions = m_regionsBefore;
+}
+
+void HatchEditCommand::redo()
+{
+    LayerEditCommand::redo();
+    *m_regions = m_regionsAfter;
+}
@@ -0,0 +1,52 @@
+#ifndef LAYERCOMMAND_H
+#define LAYERCOMMAND_H
+
+#include "hatchpatterncache.h"
+#include "layerstack.h"
+#include <QImage>
+#include <QUndoCommand>
+
+// Отменяемое изменение прямоугольника одного слоя: хранит пиксели до и после
+class LayerEditCommand : public QUndoCommand
+{
+public:
+    LayerEditCommand(LayerStack *layers, LayerStack::LayerId id, const QRect &rect,
+                     const QImage &before, const QImage &after, const QString &text);
+
+    void undo() override;
+    void redo() override;
+
+    qint64 bytes() const { return m_before.sizeInBytes() + m_after.sizeInBytes(); }
+
+private:
+    void restore(const QImage &pixels);
+
+    LayerStack *m_layers;
+    LayerStack::LayerId m_id;
+    QRect m_rect;
+    QImage m_before;
+    QImage m_after;
+    // Изменение уже сделано инструментом, первый redo() ничего не делает
+    bool m_applied = true;
+};
+
+// Изменение слоя штриховки вместе со списком заштрихованных областей
+// документа, чтобы после отмены области перерисовывались с прежними
+// параметрами
+class HatchEditCommand : public LayerEditCommand
+{
+public:
+    HatchEditCommand(LayerStack *layers, const QRect &rect, const QImage &before, const QImage &after,
+                     QVector<HatchedRegion> *regions, const QVector<HatchedRegion> &regionsBefore,
+                     const QVector<HatchedRegion> &regionsAfter, const QString &text);
+
+    void undo() override;
+    void redo() override;
+
+private:
+    QVector<HatchedRegion> *m_regions;
+    QVector<HatchedRegion> m_regionsBefore;
+    QVector<HatchedRegion> m_regionsAfter;
+};
+
+#endif // LAYERCOMMAND_H
@@ -0,0 +1,274 @@
+#include "layerstack.h"
+#include "parallel.h"
+#include <QCoreApplication>
+#include <QPainter>
+#include <algorithm>
+#include <cstring>
+
+LayerStack::LayerStack()
+{
+    m_layers[ScanLayer].name = QCoreApplication::translate("LayerStack", "Скан");
+    m_layers[ScanOutlineLayer].name = QCoreApplication::translate("LayerStack", "Контуры скана");
+    m_layers[ScanOutlineLayer].visible = false;
+    m_layers[HatchLayer].name = QCoreApplication::translate("LayerStack", "Штриховка");
+    m_layers[OutlineLayer].name = QCoreApplication::translate("LayerStack", "Контуры");
+}
+
+void LayerStack::resize(const QSize &size)
+{
+    if (m_size == size)
+        return;
+    unpack();
+
+    for (int id = 0; id < LayerCount; ++id) {
+        QImage newImage(size, format(LayerId(id)));
+        newImage.fill(id == ScanLayer ? Qt::white : Qt::transparent);
+
+        if (!m_layers[id].image.isNull()) {
+            QPainter painter(&newImage);
+            painter.setCompositionMode(QPainter::CompositionMode_Source);
+            painter.drawImage(QPoint(0, 0), m_layers[id].image);
+        }
+        m_layers[id].image = newImage;
+    }
+
+    m_size = size;
+    m_columns = (size.width() + TileSize - 1) / TileSize;
+    m_rows = (size.height() + TileSize - 1) / TileSize;
+    resizeCache(m_composite);
+    resizeCache(m_boundary);
+    ++m_boundaryRevision;
+}
+
+void LayerStack::setVisible(LayerId id, bool visible)
+{
+    if (m_layers[id].visible == visible)
+        return;
+    m_layers[id].visible = visible;
+    invalidate(m_composite, rect());
+}
+
+void LayerStack::setOpacity(LayerId id, qreal opacity)
+{
+    opacity = qBound(qreal(0), opacity, qreal(1));
+    if (m_layers[id].opacity == opacity)
+        return;
+    m_layers[id].opacity = opacity;
+    invalidate(m_composite, rect());
+}
+
+void LayerStack::clear()
+{
+    unpack();
+    for (int id = 0; id < LayerCount; ++id)
+        m_layers[id].image.fill(id == ScanLayer ? Qt::white : Qt::transparent);
+    markAllDirty();
+}
+
+void LayerStack::markDirty(LayerId id, const QRect &rect)
+{
+    invalidate(m_composite, rect);
+    if (id != HatchLayer) {
+        invalidate(m_boundary, rect);
+        ++m_boundaryRevision;
+    }
+}
+
+void LayerStack::markAllDirty()
+{
+    invalidate(m_composite, rect());
+    invalidate(m_boundary, rect());
+    ++m_boundaryRevision;
+}
+
+const QImage &LayerStack::composite(const QRect &rect)
+{
+    unpack();
+    return update(m_composite, rect, false);
+}
+
+const QImage &LayerStack::boundary()
+{
+    unpack();
+    return update(m_boundary, rect(), true);
+}
+
+QImage LayerStack::flatten() const
+{
+    QImage result(m_size, QImage::Format_RGB32);
+    QPainter painter(&result);
+    compose(painter, rect(), false);
+    return result;
+}
+
+qint64 LayerStack::layerBytes() const
+{
+    qint64 bytes = 0;
+    for (const Layer &layer : m_layers) {
+        bytes += layer.image.sizeInBytes();
+        for (const PackedTile &tile : layer.packed)
+            bytes += qint64(sizeof(PackedTile)) + tile.data.size();
+    }
+    return bytes;
+}
+
+qint64 LayerStack::cacheBytes() const
+{
+    return m_composite.image.sizeInBytes() + m_boundary.image.sizeInBytes();
+}
+
+qint64 LayerStack::dropCaches()
+{
+    const qint64 freed = cacheBytes();
+    m_composite.image = QImage();
+    m_boundary.image = QImage();
+    m_composite.dirty.fill(true);
+    m_boundary.dirty.fill(true);
+    // Маски заливки читают контуры напрямую и должны перестроиться
+    ++m_boundaryRevision;
+    return freed;
+}
+
+qint64 LayerStack::pack()
+{
+    if (m_packed || m_size.isEmpty())
+        return 0;
+
+    const qint64 before = layerBytes() + dropCaches();
+    const int tiles = m_columns * m_rows;
+    for (Layer &layer : m_layers) {
+        const QImage &image = layer.image;
+        layer.packed.resize(tiles);
+        PackedTile *packed = layer.packed.data();
+        parallelFor(tiles, [&](int index) {
+            const QRect rect = tileRect(index);
+            const QRgb first = reinterpret_cast<const QRgb *>(image.constScanLine(rect.top()))[rect.left()];
+            bool uniform = true;
+            QByteArray raw;
+            raw.reserve(rect.width() * rect.height() * int(sizeof(QRgb)));
+            for (int y = rect.top(); y <= rect.bottom(); ++y) {
+                const QRgb *line = reinterpret_cast<const QRgb *>(image.constScanLine(y)) + rect.left();
+                for (int x = 0; uniform && x < rect.width(); ++x)
+                    uniform = line[x] == first;
+                raw.append(reinterpret_cast<const char *>(line), rect.width() * int(sizeof(QRgb)));
+            }
+            packed[index].fill = first;
+            packed[index].data = uniform ? QByteArray() : qCompress(raw, 1);
+        });
+        layer.image = QImage();
+    }
+    m_packed = true;
+    return before - layerBytes();
+}
+
+void LayerStack::unpack()
+{
+    if (!m_packed)
+        return;
+
+    for (int id = 0; id < LayerCount; ++id) {
+        Layer &layer = m_layers[id];
+        layer.image = QImage(m_size, format(LayerId(id)));
+        // bits() отсоединяет изображение; из потоков пишутся только строки тайлов
+        uchar *bits = layer.image.bits();
+        const qsizetype bytesPerLine = layer.image.bytesPerLine();
+        const PackedTile *packed = layer.packed.constData();
+        parallelFor(layer.packed.size(), [&](int index) {
+            const QRect rect = tileRect(index);
+            const PackedTile &tile = packed[index];
+            const QByteArray raw = tile.data.isEmpty() ? QByteArray() : qUncompress(tile.data);
+            const int rowBytes = rect.width() * int(sizeof(QRgb));
+            for (int y = rect.top(); y <= rect.bottom(); ++y) {
+                QRgb *line = reinterpret_cast<QRgb *>(bits + y * bytesPerLine) + rect.left();
+                if (raw.isEmpty())
+                    std::fill(line, line + rect.width(), tile.fill);
+                else
+                    std::memcpy(line, raw.constData() + (y - rect.top()) * rowBytes, size_t(rowBytes));
+            }
+        });
+        layer.packed = QVector<PackedTile>();
+    }
+    m_packed = false;
+    markAllDirty();
+}
+
+QImage::Format LayerStack::format(LayerId id)
+{
+    // Скан непрозрачен; остальные слои хранятся с предумножением, как
+    // их рисует QPainter, поэтому наложение обходится без преобразований
+    return id == ScanLayer ? QImage::Format_RGB32 : QImage::Format_ARGB32_Premultiplied;
+}
+
+QRect LayerStack::tileRect(int index) const
+{
+    const int row = index / m_columns;
+    const int column = index % m_columns;
+    return QRect(column * TileSize, row * TileSize, TileSize, TileSize).intersected(rect());
+}
+
+void LayerStack::resizeCache(TileCache &cache)
+{
+    // Композиция всегда непрозрачна: под слоями белый лист
+    cache.image = QImage(m_size, QImage::Format_RGB32);
+    cache.dirty = QBitArray(m_columns * m_rows, true);
+}
+
+void LayerStack::invalidate(TileCache &cache, const QRect &rect)
+{
+    const QRect area = rect.intersected(this->rect());
+    if (area.isEmpty())
+        return;
+
+    for (int row = area.top() / TileSize; row <= area.bottom() / TileSize; ++row) {
+        for (int column = area.left() / TileSize; column <= area.right() / TileSize; ++column)
+            cache.dirty.setBit(row * m_columns + column);
+    }
+}
+
+void LayerStack::compose(QPainter &painter, const QRect &rect, bool boundaryOnly) const
+{
+    painter.setOpacity(1.0);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.fillRect(rect, Qt::white);
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+
+    for (int id = 0; id < LayerCount; ++id) {
+        const Layer &layer = m_layers[id];
+        if (boundaryOnly) {
+            // Сырой скан с шумом и полутонами заменяется его контурами
+            if (id == ScanLayer || id == HatchLayer)
+                continue;
+        } else {
+            if (!layer.visible || layer.opacity <= 0)
+                continue;
+            painter.setOpacity(layer.opacity);
+        }
+        painter.drawImage(rect, layer.image, rect);
+    }
+}
+
+const QImage &LayerStack::update(TileCache &cache, const QRect &rect, bool boundaryOnly)
+{
+    const QRect area = rect.intersected(this->rect());
+    if (area.isEmpty())
+        return cache.image;
+    if (cache.image.isNull())
+        resizeCache(cache);
+
+    QPainter painter;
+    for (int row = area.top() / TileSize; row <= area.bottom() / TileSize; ++row) {
+        for (int column = area.left() / TileSize; column <= area.right() / TileSize; ++column) {
+            const int index = row * m_columns + column;
+            if (!cache.dirty.testBit(index))
+                continue;
+
+            const QRect tile = QRect(column * TileSize, row * TileSize, TileSize, TileSize)
+                                   .intersected(this->rect());
+            if (!painter.isActive())
+                painter.begin(&cache.image);
+            compose(painter, tile, boundaryOnly);
+            cache.dirty.clearBit(index);
+        }
+    }
+    return cache.image;
+}
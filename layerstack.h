@@ -0,0 +1,116 @@
+#ifndef LAYERSTACK_H
+#define LAYERSTACK_H
+
+#include <QBitArray>
+#include <QByteArray>
+#include <QImage>
+#include <QRect>
+#include <QString>
+#include <QVector>
+
+class QPainter;
+
+// Слои документа и кэш их композиции. Каждый слой хранит изображение во
+// весь лист; кэш композиции разбит на тайлы и пересобирает только те из
+// них, что изменились с прошлого кадра.
+class LayerStack
+{
+public:
+    // Порядок перечисления совпадает с порядком наложения снизу вверх
+    enum LayerId {
+        ScanLayer,
+        ScanOutlineLayer,
+        HatchLayer,
+        OutlineLayer,
+        LayerCount
+    };
+
+    static const int TileSize = 128;
+
+    LayerStack();
+
+    void resize(const QSize &size);
+    QSize size() const { return m_size; }
+    QRect rect() const { return QRect(QPoint(0, 0), m_size); }
+
+    // Неконстантный доступ распаковывает упакованный стек (см. pack())
+    QImage &image(LayerId id) { unpack(); return m_layers[id].image; }
+    const QImage &image(LayerId id) const { return m_layers[id].image; }
+
+    QString name(LayerId id) const { return m_layers[id].name; }
+    bool isVisible(LayerId id) const { return m_layers[id].visible; }
+    qreal opacity(LayerId id) const { return m_layers[id].opacity; }
+    void setVisible(LayerId id, bool visible);
+    void setOpacity(LayerId id, qreal opacity);
+
+    // Скан заливается белым, остальные слои становятся прозрачными
+    void clear();
+
+    // Сообщить об изменении пикселей слоя в прямоугольнике rect
+    void markDirty(LayerId id, const QRect &rect);
+    void markAllDirty();
+
+    // Композиция видимых слоёв; пересобираются только грязные тайлы в rect
+    const QImage &composite(const QRect &rect);
+    // Контуры для заливки: очищенные контуры скана и карандаш без штриховки
+    const QImage &boundary();
+    // Счётчик изменений контуров; растёт при каждом изменении boundary()
+    quint64 boundaryRevision() const { return m_boundaryRevision; }
+    // Полная композиция для сохранения. Стек должен быть распакован
+    QImage flatten() const;
+
+    // Память пикселей слоёв и кэшей композиции
+    qint64 layerBytes() const;
+    qint64 cacheBytes() const;
+    // Освобождает кэши композиции; они пересобираются при следующем запросе.
+    // Возвращает число освобождённых байт
+    qint64 dropCaches();
+
+    // Неактивный документ: кэши освобождаются, слои хранятся сжатыми тайлами
+    // TileSize × TileSize (однотонный тайл — одним цветом). Тайлы сжимаются
+    // и распаковываются параллельно. pack() возвращает число освобождённых байт
+    qint64 pack();
+    void unpack();
+    bool isPacked() const { return m_packed; }
+
+private:
+    // Сжатый тайл слоя; пустой data — тайл целиком цвета fill
+    struct PackedTile
+    {
+        QRgb fill = 0;
+        QByteArray data;
+    };
+
+    struct Layer
+    {
+        QString name;
+        QImage image;
+        QVector<PackedTile> packed;
+        bool visible = true;
+        qreal opacity = 1.0;
+    };
+
+    struct TileCache
+    {
+        QImage image;
+        QBitArray dirty;
+    };
+
+    static QImage::Format format(LayerId id);
+    QRect tileRect(int index) const;
+    void resizeCache(TileCache &cache);
+    void invalidate(TileCache &cache, const QRect &rect);
+    void compose(QPainter &painter, const QRect &rect, bool boundaryOnly) const;
+    const QImage &update(TileCache &cache, const QRect &rect, bool boundaryOnly);
+
+    Layer m_layers[LayerCount];
+    TileCache m_composite;
+    TileCache m_boundary;
+    quint64 m_boundaryRevision = 0;
+    bool m_packed = false;
+    QSize m_size;
+    int m_columns = 0;
+    int m_rows = 0;
+};
+
+#endif // LAYERSTACK_H
@@ -1,13 +1,78 @@
 #include <QApplication>
+#include <QCommandLineParser>
+#include <cstdio>
+#include <cstring>
+#include "benchmark.h"
 #include "mainwindow.h"
+#include "memoryaccountant.h"
+#include "renderservice.h"
+#include "startupprofile.h"
 
 int main(int argc, char *argv[])
 {
+    StartupProfile::start();
+    // Фоновому режиму не нужен дисплей
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--serve") == 0 && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
     QApplication app(argc, argv);
+    StartupProfile::mark("QApplication");
 
     QLocale::setDefault(QLocale(QLocale::Russian, QLocale::Russia));
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption benchmarkOption("benchmark", "Run drawing benchmarks and exit.");
+    parser.addOption(benchmarkOption);
+    QCommandLineOption startupProfileOption("startup-profile",
+                                            "Print startup timings up to the first paint and exit.");
+    parser.addOption(startupProfileOption);
+    QCommandLineOption memoryBudgetOption("memory-budget",
+                                          "Cache memory budget in MiB, 0 for unlimited.", "MiB");
+    parser.addOption(memoryBudgetOption);
+    QCommandLineOption memoryReportOption("memory-report",
+                                          "Print memory usage by category on exit.");
+    parser.addOption(memoryReportOption);
+    QCommandLineOption serveOption("serve",
+                                   "Run headless, accepting line commands on the local socket <name>.",
+                                   "name");
+    parser.addOption(serveOption);
+    parser.process(app);
+
+    MemoryAccountant &memory = MemoryAccountant::instance();
+    if (parser.isSet(memoryBudgetOption))
+        memory.setBudget(parser.value(memoryBudgetOption).toLongLong() * 1024 * 1024);
+    const bool memoryReport = parser.isSet(memoryReportOption);
+
+    if (parser.isSet(benchmarkOption)) {
+        Benchmark::print(Benchmark::runAll());
+        if (memoryReport)
+            printf("%s", qPrintable(memory.report()));
+        return 0;
+    }
+
+    if (parser.isSet(serveOption)) {
+        RenderService service;
+        if (!service.listen(parser.value(serveOption))) {
+            fprintf(stderr, "cannot listen on %s: %s\n", qPrintable(parser.value(serveOption)),
+                    qPrintable(service.errorString()));
+            return 1;
+        }
+        const int code = app.exec();
+        if (memoryReport)
+            printf("%s", qPrintable(memory.report()));
+        return code;
+    }
+
+    StartupProfile::setEnabled(parser.isSet(startupProfileOption));
+
     MainWindow window;
+    StartupProfile::mark("MainWindow");
     window.show();
-    return app.exec();
+    StartupProfile::mark("show");
+    const int code = app.exec();
+    if (memoryReport)
+        printf("%s", qPrintable(memory.report()));
+    return code;
 }
@@ -1,21 +1,47 @@
 #include "mainwindow.h"
+#include "hatchpatterncache.h"
+#include "memoryaccountant.h"
+#include "memorypanel.h"
 #include "paintview.h"
 
 #include <QApplication>
 #include <QColorDialog>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QImageWriter>
 #include <QInputDialog>
 #include <QActionGroup>
 #include <QMenuBar>
 #include <QMessageBox>
 #include <QCloseEvent>
+#include <QStatusBar>
+#include <QTabWidget>
+#include <QUndoGroup>
 
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), paintView(new PaintView(this))
+    : QMainWindow(parent)
+    , tabs(new QTabWidget(this))
+    , undoGroup(new QUndoGroup(this))
+    , patternCache(std::make_shared<HatchPatternCache>())
 {
-    setCentralWidget(paintView);
-
+    tabs->setDocumentMode(true);
+    tabs->setTabsClosable(true);
+    tabs->setMovable(true);
+    setCentralWidget(tabs);
+    connect(tabs, &QTabWidget::currentChanged, this, &MainWindow::activateDocument);
+    connect(tabs, &QTabWidget::tabCloseRequested, this, &MainWindow::closeDocument);
+
+    // Кэш плиток один на все документы, поэтому и учитывается один раз
+    HatchPatternCache *cache = patternCache.get();
+    patternCacheSource = MemoryAccountant::instance().addSource(MemoryAccountant::PatternCache, [cache]() {
+        return cache->stats().bytes;
+    }, [cache]() {
+        const qint64 freed = cache->stats().bytes;
+        cache->clear();
+        return freed;
+    });
+
+    addDocument();
     createActions();
     createMenus();
 
@@ -23,22 +49,179 @@ MainWindow::MainWindow(QWidget *parent)
     resize(500, 500);
 }
 
+MainWindow::~MainWindow()
+{
+    MemoryAccountant::instance().removeSource(patternCacheSource);
+}
+
 void MainWindow::closeEvent(QCloseEvent *event)
 {
-    if (maybeSave())
-        event->accept();
-    else
-        event->ignore();
+    for (int i = 0; i < tabs->count(); ++i) {
+        if (!qobject_cast<PaintView *>(tabs->widget(i))->isModified())
+            continue;
+        tabs->setCurrentIndex(i);
+        if (!maybeSave()) {
+            event->ignore();
+            return;
+        }
+    }
+    event->accept();
+}
+
+void MainWindow::newDocument()
+{
+    addDocument();
 }
 
 void MainWindow::open()
 {
-    if (maybeSave()) {
-        QString fileName = QFileDialog::getOpenFileName(this,
-                                                        tr("Open File"), QDir::currentPath());
-        if (!fileName.isEmpty())
-            paintView->openImage(fileName);
+    QString fileName = QFileDialog::getOpenFileName(this,
+                                                    tr("Open File"), QDir::currentPath());
+    if (fileName.isEmpty())
+        return;
+
+    // Нетронутый пустой документ заменяется, иначе файл открывается в новой вкладке
+    const bool reuse = !paintView->isModified() && paintView->undoStack()->count() == 0
+                       && paintView->windowFilePath().isEmpty();
+    PaintView *view = reuse ? paintView : addDocument();
+    if (!view->openImage(fileName)) {
+        if (!reuse)
+            closeDocument(documentIndex(view));
+        QMessageBox::warning(this, tr("Scribble"), tr("Не удалось открыть файл «%1».").arg(fileName));
+        return;
+    }
+
+    view->setWindowFilePath(fileName);
+    view->setWindowTitle(QFileInfo(fileName).fileName());
+    updateDocumentTitle();
+    if (scanProcessingAct->isChecked()) {
+        const ScanProcessor::Stats &stats = view->lastScanStats();
+        statusBar()->showMessage(tr("Скан обработан за %1 мс (%2 Мпикс/с)")
+                                     .arg(stats.nsecs / 1000000.0, 0, 'f', 1)
+                                     .arg(stats.megapixelsPerSecond, 0, 'f', 1), 5000);
+    }
+}
+
+void MainWindow::closeDocument(int index)
+{
+    PaintView *view = qobject_cast<PaintView *>(tabs->widget(index));
+    if (!view)
+        return;
+
+    if (view->isModified()) {
+        tabs->setCurrentIndex(index);
+        if (!maybeSave())
+            return;
+    }
+
+    // Закрываемый документ не сжимается при переключении вкладки
+    if (view == paintView)
+        paintView = nullptr;
+    tabs->removeTab(index);
+    view->deleteLater();
+    if (tabs->count() == 0)
+        addDocument();
+}
+
+void MainWindow::closeCurrentDocument()
+{
+    closeDocument(tabs->currentIndex());
+}
+
+void MainWindow::activateDocument(int index)
+{
+    PaintView *view = qobject_cast<PaintView *>(tabs->widget(index));
+    if (paintView && paintView != view)
+        paintView->setActive(false);
+    paintView = view;
+    if (!view)
+        return;
+
+    view->setActive(true);
+    undoGroup->setActiveStack(view->undoStack());
+    syncDocumentActions();
+}
+
+void MainWindow::updateDocumentTitle()
+{
+    for (int i = 0; i < tabs->count(); ++i)
+        tabs->setTabText(i, documentTitle(qobject_cast<PaintView *>(tabs->widget(i))));
+}
+
+PaintView *MainWindow::addDocument(const QString &title)
+{
+    PaintView *view = new PaintView;
+    view->setWindowTitle(title.isEmpty() ? tr("Без имени %1").arg(++untitledCount) : title);
+    view->setPatternCache(patternCache);
+
+    // Настройки переносятся из текущего документа и из меню
+    if (paintView) {
+        view->setPenColor(paintView->penColor());
+        view->setPenWidth(paintView->penWidth());
+        // Материал задаёт семейство рисунка и сбрасывает угол и шаг к
+        // своим значениям, поэтому ставится первым
+        view->setHatchType(paintView->hatchType());
+        view->setHatchAngle(paintView->hatchAngle());
+        view->setHatchSpacing(paintView->hatchSpacing());
+        view->setCrossHatching(paintView->isCrossHatching());
+        view->setMeasurementScale(paintView->measurementDpi(), paintView->measurementScale());
+    }
+    // Первый документ создаётся до действий меню
+    if (!layerVisibilityActs.isEmpty()) {
+        view->setStrokeSmoothing(strokeSmoothingAct->isChecked());
+        view->setAntialiasAwareFill(antialiasAwareFillAct->isChecked());
+        view->setScanProcessing(scanProcessingAct->isChecked());
+        view->setScanThinning(scanThinningAct->isChecked());
+    }
+
+    connect(view, &PaintView::regionsMeasured, this, &MainWindow::showMeasurement);
+    connect(view, &PaintView::hatchSettingsChanged, this, &MainWindow::syncDocumentActions);
+    // Заголовок обновляется по шагам отмены, а не по каждому отрезку штриха
+    connect(view->undoStack(), &QUndoStack::indexChanged, this, &MainWindow::updateDocumentTitle);
+    connect(view->undoStack(), &QUndoStack::cleanChanged, this, &MainWindow::updateDocumentTitle);
+    undoGroup->addStack(view->undoStack());
+
+    const int index = tabs->addTab(view, documentTitle(view));
+    tabs->setCurrentIndex(index);
+    return view;
+}
+
+int MainWindow::documentIndex(const PaintView *view) const
+{
+    for (int i = 0; i < tabs->count(); ++i) {
+        if (tabs->widget(i) == view)
+            return i;
     }
+    return -1;
+}
+
+QString MainWindow::documentTitle(const PaintView *view) const
+{
+    if (!view)
+        return QString();
+    return view->isModified() ? view->windowTitle() + QLatin1Char('*') : view->windowTitle();
+}
+
+void MainWindow::syncDocumentActions()
+{
+    // Действия создаются после первого документа
+    if (layerVisibilityActs.isEmpty())
+        return;
+
+    for (QAction *action : std::as_const(layerVisibilityActs)) {
+        const QSignalBlocker blocker(action);
+        action->setChecked(paintView->isLayerVisible(LayerStack::LayerId(action->data().toInt())));
+    }
+    // Для инструмента штриховки отмечается материал документа
+    QAction *const materialActs[] = {
+        hatchingMetalAct, hatchingNonMetalAct, hatchingWoodAct,
+        hatchingStoneAct, hatchingCeramicAct, hatchingConcreteAct,
+        hatchingGlassAct, hatchingLiquidAct, hatchingSoilAct
+    };
+    if (qobject_cast<HatchingTool *>(paintView->currentTool()))
+        materialActs[paintView->hatchType()]->setChecked(true);
+    else
+        penToolAct->setChecked(true);
 }
 
 void MainWindow::setPenTool()
@@ -130,12 +313,17 @@ void MainWindow::penWidth()
         paintView->setPenWidth(newWidth);
 }
 
+void MainWindow::setStrokeSmoothing(bool enabled)
+{
+    paintView->setStrokeSmoothing(enabled);
+}
+
 void MainWindow::setHatchAngle()
 {
     bool ok;
     int angle = QInputDialog::getInt(this, tr("Угол штриховки"),
                                      tr("Введите угол штриховки (0-180 градусов):"),
-                                     45, 0, 180, 1, &ok);
+                                     paintView->hatchAngle(), 0, 180, 1, &ok);
     if (ok)
         paintView->setHatchAngle(angle);
 }
@@ -145,11 +333,90 @@ void MainWindow::setHatchSpacing()
     bool ok;
     int spacing = QInputDialog::getInt(this, tr("Расстояние между линиями"),
                                        tr("Введите расстояние между линиями штриховки:"),
-                                       10, 1, 50, 1, &ok);
+                                       paintView->hatchSpacing(), 1, 50, 1, &ok);
     if (ok)
         paintView->setHatchSpacing(spacing);
 }
 
+void MainWindow::setAntialiasAwareFill(bool enabled)
+{
+    paintView->setAntialiasAwareFill(enabled);
+}
+
+void MainWindow::setMeasurementScale()
+{
+    bool ok;
+    const double dpi = QInputDialog::getDouble(this, tr("Масштаб измерений"),
+                                               tr("Разрешение изображения (точек на дюйм):"),
+                                               paintView->measurementDpi(), 1, 10000, 1, &ok);
+    if (!ok)
+        return;
+    const double scale = QInputDialog::getDouble(this, tr("Масштаб измерений"),
+                                                 tr("Масштаб чертежа 1:"),
+                                                 paintView->measurementScale(), 0.01, 100000, 2, &ok);
+    if (ok)
+        paintView->setMeasurementScale(dpi, scale);
+}
+
+void MainWindow::showMeasurement()
+{
+    const HatchingTool::Measurement &m = paintView->lastMeasurement();
+    if (m.regions == 0)
+        return;
+
+    const QPointF centroid = m.centroidMm();
+    const QSizeF bounds = m.boundsMm();
+    QString text = tr("Площадь %1 мм², периметр %2 мм, центр (%3; %4) мм, габарит %5×%6 мм")
+                       .arg(m.areaMm2(), 0, 'f', 1)
+                       .arg(m.perimeterMm(), 0, 'f', 1)
+                       .arg(centroid.x(), 0, 'f', 1)
+                       .arg(centroid.y(), 0, 'f', 1)
+                       .arg(bounds.width(), 0, 'f', 1)
+                       .arg(bounds.height(), 0, 'f', 1);
+    if (m.regions > 1)
+        text += tr(", областей: %1").arg(m.regions);
+    statusBar()->showMessage(text);
+}
+
+void MainWindow::showMemoryPanel()
+{
+    if (!memoryPanel)
+        memoryPanel = new MemoryPanel(this);
+    memoryPanel->show();
+    memoryPanel->raise();
+    memoryPanel->activateWindow();
+}
+
+void MainWindow::setScanProcessing(bool enabled)
+{
+    paintView->setScanProcessing(enabled);
+    scanThinningAct->setEnabled(enabled);
+}
+
+void MainWindow::setScanThinning(bool enabled)
+{
+    paintView->setScanThinning(enabled);
+}
+
+void MainWindow::setLayerVisible(bool visible)
+{
+    QAction *action = qobject_cast<QAction *>(sender());
+    paintView->setLayerVisible(LayerStack::LayerId(action->data().toInt()), visible);
+}
+
+void MainWindow::setLayerOpacity()
+{
+    QAction *action = qobject_cast<QAction *>(sender());
+    const LayerStack::LayerId id = LayerStack::LayerId(action->data().toInt());
+
+    bool ok;
+    int opacity = QInputDialog::getInt(this, tr("Непрозрачность слоя"),
+                                       tr("Непрозрачность слоя «%1» (0-100%):").arg(paintView->layerName(id)),
+                                       qRound(paintView->layerOpacity(id) * 100), 0, 100, 1, &ok);
+    if (ok)
+        paintView->setLayerOpacity(id, opacity / 100.0);
+}
+
 void MainWindow::about()
 {
     QMessageBox::about(this, tr("About Scribble"),
@@ -166,12 +433,13 @@ void MainWindow::about()
                           "to repaint widgets.</p>"));
 }
 
-void MainWindow::createActions()
+void MainWindow::populateSaveAsMenu()
 {
-    openAct = new QAction(tr("&Open..."), this);
-    openAct->setShortcuts(QKeySequence::Open);
-    connect(openAct, &QAction::triggered, this, &MainWindow::open);
+    if (!saveAsActs.isEmpty())
+        return;
 
+    // Список форматов загружает все модули изображений, поэтому он
+    // строится при первом открытии меню, а не при запуске
     const QList<QByteArray> imageFormats = QImageWriter::supportedImageFormats();
     for (const QByteArray &format : imageFormats) {
         QString text = tr("%1...").arg(QString::fromLatin1(format).toUpper());
@@ -180,7 +448,30 @@ void MainWindow::createActions()
         action->setData(format);
         connect(action, &QAction::triggered, this, &MainWindow::save);
         saveAsActs.append(action);
+        saveAsMenu->addAction(action);
     }
+}
+
+void MainWindow::createActions()
+{
+    newAct = new QAction(tr("&Новый"), this);
+    newAct->setShortcuts(QKeySequence::New);
+    connect(newAct, &QAction::triggered, this, &MainWindow::newDocument);
+
+    openAct = new QAction(tr("&Open..."), this);
+    openAct->setShortcuts(QKeySequence::Open);
+    connect(openAct, &QAction::triggered, this, &MainWindow::open);
+
+    closeAct = new QAction(tr("&Закрыть"), this);
+    closeAct->setShortcuts(QKeySequence::Close);
+    connect(closeAct, &QAction::triggered, this, &MainWindow::closeCurrentDocument);
+
+    // Отмена и повтор относятся к документу текущей вкладки
+    undoAct = undoGroup->createUndoAction(this, tr("&Отменить"));
+    undoAct->setShortcuts(QKeySequence::Undo);
+
+    redoAct = undoGroup->createRedoAction(this, tr("&Повторить"));
+    redoAct->setShortcuts(QKeySequence::Redo);
 
     exitAct = new QAction(tr("E&xit"), this);
     exitAct->setShortcuts(QKeySequence::Quit);
@@ -192,6 +483,11 @@ void MainWindow::createActions()
     penWidthAct = new QAction(tr("Pen &Width..."), this);
     connect(penWidthAct, &QAction::triggered, this, &MainWindow::penWidth);
 
+    strokeSmoothingAct = new QAction(tr("&Сглаживание штрихов"), this);
+    strokeSmoothingAct->setCheckable(true);
+    strokeSmoothingAct->setChecked(true);
+    connect(strokeSmoothingAct, &QAction::toggled, this, &MainWindow::setStrokeSmoothing);
+
     penToolAct = new QAction(tr("&Карандаш"), this);
     penToolAct->setCheckable(true);
     penToolAct->setChecked(true);
@@ -259,10 +555,49 @@ void MainWindow::createActions()
     hatchSpacingAct = new QAction(tr("&Расстояние между линиями..."), this);
     connect(hatchSpacingAct, &QAction::triggered, this, &MainWindow::setHatchSpacing);
 
+    antialiasAwareFillAct = new QAction(tr("Штриховать &сглаженные края"), this);
+    antialiasAwareFillAct->setCheckable(true);
+    antialiasAwareFillAct->setChecked(true);
+    connect(antialiasAwareFillAct, &QAction::toggled, this, &MainWindow::setAntialiasAwareFill);
+
+    scanProcessingAct = new QAction(tr("&Очищать сканы при открытии"), this);
+    scanProcessingAct->setCheckable(true);
+    scanProcessingAct->setChecked(true);
+    connect(scanProcessingAct, &QAction::toggled, this, &MainWindow::setScanProcessing);
+
+    scanThinningAct = new QAction(tr("&Утончать линии скана"), this);
+    scanThinningAct->setCheckable(true);
+    scanThinningAct->setChecked(false);
+    connect(scanThinningAct, &QAction::toggled, this, &MainWindow::setScanThinning);
+
+    measurementScaleAct = new QAction(tr("Масштаб &измерений..."), this);
+    connect(measurementScaleAct, &QAction::triggered, this, &MainWindow::setMeasurementScale);
+
+    memoryPanelAct = new QAction(tr("&Память..."), this);
+    connect(memoryPanelAct, &QAction::triggered, this, &MainWindow::showMemoryPanel);
+
+    for (int id = 0; id < LayerStack::LayerCount; ++id) {
+        const QString name = paintView->layerName(LayerStack::LayerId(id));
+
+        QAction *visibilityAction = new QAction(name, this);
+        visibilityAction->setCheckable(true);
+        visibilityAction->setChecked(paintView->isLayerVisible(LayerStack::LayerId(id)));
+        visibilityAction->setData(id);
+        connect(visibilityAction, &QAction::toggled, this, &MainWindow::setLayerVisible);
+        layerVisibilityActs.append(visibilityAction);
+
+        QAction *opacityAction = new QAction(tr("Непрозрачность: %1...").arg(name), this);
+        opacityAction->setData(id);
+        connect(opacityAction, &QAction::triggered, this, &MainWindow::setLayerOpacity);
+        layerOpacityActs.append(opacityAction);
+    }
+
     clearScreenAct = new QAction(tr("&Clear Screen"), this);
     clearScreenAct->setShortcut(tr("Ctrl+L"));
-    connect(clearScreenAct, &QAction::triggered,
-            paintView, &PaintView::clearImage);
+    connect(clearScreenAct, &QAction::triggered, this, [this]() {
+        paintView->clearImage();
+        updateDocumentTitle();
+    });
 
     aboutAct = new QAction(tr("&About"), this);
     connect(aboutAct, &QAction::triggered, this, &MainWindow::about);
@@ -274,15 +609,20 @@ void MainWindow::createActions()
 void MainWindow::createMenus()
 {
     saveAsMenu = new QMenu(tr("&Save As"), this);
-    for (QAction *action : std::as_const(saveAsActs))
-        saveAsMenu->addAction(action);
+    connect(saveAsMenu, &QMenu::aboutToShow, this, &MainWindow::populateSaveAsMenu);
 
     fileMenu = new QMenu(tr("&File"), this);
+    fileMenu->addAction(newAct);
     fileMenu->addAction(openAct);
     fileMenu->addMenu(saveAsMenu);
+    fileMenu->addAction(closeAct);
     fileMenu->addSeparator();
     fileMenu->addAction(exitAct);
 
+    editMenu = new QMenu(tr("&Правка"), this);
+    editMenu->addAction(undoAct);
+    editMenu->addAction(redoAct);
+
     hatchingSubMenu = new QMenu(tr("&Штриховка"), this);
     hatchingSubMenu->addAction(hatchingMetalAct);
     hatchingSubMenu->addAction(hatchingNonMetalAct);
@@ -299,12 +639,27 @@ void MainWindow::createMenus()
     toolsMenu->addAction(hatchingToolAct);
     toolsMenu->addMenu(hatchingSubMenu);
 
+    layersMenu = new QMenu(tr("&Слои"), this);
+    for (QAction *action : std::as_const(layerVisibilityActs))
+        layersMenu->addAction(action);
+    layersMenu->addSeparator();
+    for (QAction *action : std::as_const(layerOpacityActs))
+        layersMenu->addAction(action);
+
     optionMenu = new QMenu(tr("&Options"), this);
     optionMenu->addAction(penColorAct);
     optionMenu->addAction(penWidthAct);
+    optionMenu->addAction(strokeSmoothingAct);
     optionMenu->addSeparator();
     optionMenu->addAction(hatchAngleAct);
     optionMenu->addAction(hatchSpacingAct);
+    optionMenu->addAction(antialiasAwareFillAct);
+    optionMenu->addAction(measurementScaleAct);
+    optionMenu->addSeparator();
+    optionMenu->addAction(scanProcessingAct);
+    optionMenu->addAction(scanThinningAct);
+    optionMenu->addSeparator();
+    optionMenu->addAction(memoryPanelAct);
     optionMenu->addSeparator();
     optionMenu->addAction(clearScreenAct);
 
@@ -313,7 +668,9 @@ void MainWindow::createMenus()
     helpMenu->addAction(aboutQtAct);
 
     menuBar()->addMenu(fileMenu);
+    menuBar()->addMenu(editMenu);
     menuBar()->addMenu(toolsMenu);
+    menuBar()->addMenu(layersMenu);
     menuBar()->addMenu(optionMenu);
     menuBar()->addMenu(helpMenu);
 }
@@ -346,5 +703,11 @@ bool MainWindow::saveFile(const QByteArray &fileFormat)
                                                         .arg(QString::fromLatin1(fileFormat)));
     if (fileName.isEmpty())
         return false;
-    return paintView->saveImage(fileName, fileFormat.constData());
+    if (!paintView->saveImage(fileName, fileFormat.constData()))
+        return false;
+
+    paintView->setWindowFilePath(fileName);
+    paintView->setWindowTitle(QFileInfo(fileName).fileName());
+    updateDocumentTitle();
+    return true;
 }
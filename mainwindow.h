@@ -3,24 +3,36 @@
 
 #include <QList>
 #include <QMainWindow>
+#include <memory>
 
 class PaintView;
 class HatchingTool;
+class HatchPatternCache;
+class MemoryPanel;
+class QTabWidget;
+class QUndoGroup;
 
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
 public:
     MainWindow(QWidget *parent = nullptr);
+    ~MainWindow() override;
 
 protected:
     void closeEvent(QCloseEvent *event) override;
 
 private slots:
+    void newDocument();
     void open();
+    void closeDocument(int index);
+    void closeCurrentDocument();
+    void activateDocument(int index);
+    void updateDocumentTitle();
     void save();
     void penColor();
     void penWidth();
+    void setStrokeSmoothing(bool enabled);
     void about();
     void setPenTool();
     void setHatchingTool();
@@ -37,23 +49,52 @@ private slots:
 
     void setHatchAngle();
     void setHatchSpacing();
+    void setAntialiasAwareFill(bool enabled);
+    void setMeasurementScale();
+    void showMeasurement();
+    void setScanProcessing(bool enabled);
+    void setScanThinning(bool enabled);
+
+    void setLayerVisible(bool visible);
+    void setLayerOpacity();
+    void showMemoryPanel();
 
 private:
     void createActions();
     void createMenus();
+    void populateSaveAsMenu();
     bool maybeSave();
     bool saveFile(const QByteArray &fileFormat);
 
-    PaintView *paintView;
+    // Новый документ во вкладке; настройки берутся из текущего документа
+    PaintView *addDocument(const QString &title = QString());
+    int documentIndex(const PaintView *view) const;
+    QString documentTitle(const PaintView *view) const;
+    void syncDocumentActions();
+
+    // Документы открыты во вкладках; paintView — документ текущей вкладки.
+    // Кэш плиток штриховки общий для всех документов, пул потоков у них
+    // и так общий (QThreadPool::globalInstance)
+    QTabWidget *tabs;
+    QUndoGroup *undoGroup;
+    PaintView *paintView = nullptr;
+    std::shared_ptr<HatchPatternCache> patternCache;
+    int patternCacheSource = 0;
+    int untitledCount = 0;
+    MemoryPanel *memoryPanel = nullptr;
 
     QMenu *toolsMenu;
     QMenu *saveAsMenu;
     QMenu *fileMenu;
+    QMenu *editMenu;
     QMenu *optionMenu;
     QMenu *helpMenu;
     QMenu *hatchingSubMenu;
+    QMenu *layersMenu;
 
     QList<QAction *> saveAsActs;
+    QList<QAction *> layerVisibilityActs;
+    QList<QAction *> layerOpacityActs;
     QAction *penToolAct;
     QAction *hatchingToolAct;
 
@@ -67,15 +108,25 @@ private:
     QAction *hatchingLiquidAct;
     QAction *hatchingSoilAct;
 
+    QAction *undoAct;
+    QAction *redoAct;
+    QAction *newAct;
     QAction *openAct;
+    QAction *closeAct;
     QAction *exitAct;
     QAction *penColorAct;
     QAction *penWidthAct;
+    QAction *strokeSmoothingAct;
     QAction *clearScreenAct;
     QAction *aboutAct;
     QAction *aboutQtAct;
     QAction *hatchAngleAct;
     QAction *hatchSpacingAct;
+    QAction *antialiasAwareFillAct;
+    QAction *scanProcessingAct;
+    QAction *scanThinningAct;
+    QAction *memoryPanelAct;
+    QAction *measurementScaleAct;
 };
 
 #endif
@@ -0,0 +1,131 @@
+#include "memoryaccountant.h"
+#include "arena.h"
+#include <QCoreApplication>
+#include <QLoggingCategory>
+
+// Освобождение кэшей по бюджету; по умолчанию не выводится,
+// включается через QT_LOGGING_RULES="draft.memory.debug=true"
+Q_LOGGING_CATEGORY(lcMemory, "draft.memory", QtWarningMsg)
+
+MemoryAccountant::MemoryAccountant()
+{
+    // Учитывается только арена главного потока: её можно освободить между
+    // операциями. Арены рабочих потоков пула заняты их задачами и здесь не
+    // считаются, иначе бюджет видел бы память, которую не может вернуть.
+    // Пробы и вытеснение вызываются из главного потока
+    addSource(FillTemporaries, []() { return qint64(Arena::local().capacity()); }, []() {
+        const qint64 freed = qint64(Arena::local().capacity());
+        Arena::local().release();
+        return freed;
+    });
+}
+
+MemoryAccountant &MemoryAccountant::instance()
+{
+    static MemoryAccountant accountant;
+    return accountant;
+}
+
+QString MemoryAccountant::categoryName(Category category)
+{
+    switch (category) {
+    case RegionCache: return QCoreApplication::translate("MemoryAccountant", "Кэш областей");
+    case PatternCache: return QCoreApplication::translate("MemoryAccountant", "Плитки штриховки");
+    case FillTemporaries: return QCoreApplication::translate("MemoryAccountant", "Временные данные заливки");
+    case CompositionCache: return QCoreApplication::translate("MemoryAccountant", "Кэш композиции");
+    case Canvas: return QCoreApplication::translate("MemoryAccountant", "Холст");
+    case History: return QCoreApplication::translate("MemoryAccountant", "История правок");
+    case CategoryCount: break;
+    }
+    return QString();
+}
+
+int MemoryAccountant::addSource(Category category, const Probe &probe, const Evictor &evictor)
+{
+    m_sources.append({m_nextId, category, probe, evictor});
+    return m_nextId++;
+}
+
+void MemoryAccountant::removeSource(int id)
+{
+    for (int i = 0; i < m_sources.size(); ++i) {
+        if (m_sources[i].id == id) {
+            m_sources.removeAt(i);
+            return;
+        }
+    }
+}
+
+qint64 MemoryAccountant::bytes(Category category) const
+{
+    qint64 result = 0;
+    for (const Source &source : m_sources) {
+        if (source.category == category)
+            result += source.probe();
+    }
+    return result;
+}
+
+qint64 MemoryAccountant::total() const
+{
+    qint64 result = 0;
+    for (const Source &source : m_sources)
+        result += source.probe();
+    return result;
+}
+
+qint64 MemoryAccountant::enforceBudget()
+{
+    if (m_budget <= 0)
+        return 0;
+
+    qint64 current = total();
+    qint64 freed = 0;
+    for (int category = 0; category < CategoryCount && current > m_budget; ++category) {
+        for (const Source &source : std::as_const(m_sources)) {
+            if (current <= m_budget)
+                break;
+            if (source.category != category || !source.evictor)
+                continue;
+            const qint64 released = source.evictor();
+            freed += released;
+            current -= released;
+        }
+    }
+
+    if (freed > 0) {
+        qCDebug(lcMemory) << "MemoryAccountant: over budget, freed" << freed / 1024 << "KiB; now"
+                 << current / 1024 << "KiB of" << m_budget / 1024 << "KiB";
+    }
+    return freed;
+}
+
+qint64 MemoryAccountant::evictAll()
+{
+    qint64 freed = 0;
+    for (const Source &source : std::as_const(m_sources)) {
+        if (source.evictor)
+            freed += source.evictor();
+    }
+    return freed;
+}
+
+QString MemoryAccountant::report() const
+{
+    auto megabytes = [](qint64 bytes) { return QString::number(bytes / (1024.0 * 1024.0), 'f', 2); };
+
+    QString text;
+    for (int category = 0; category < CategoryCount; ++category) {
+        text += QString("%1 %2 MiB\n")
+                    .arg(categoryName(Category(category)), -28)
+                    .arg(megabytes(bytes(Category(category))), 9);
+    }
+    text += QString("%1 %2 MiB\n")
+                .arg(QCoreApplication::translate("MemoryAccountant", "Всего"), -28)
+                .arg(megabytes(total()), 9);
+    text += QString("%1 %2\n")
+                .arg(QCoreApplication::translate("MemoryAccountant", "Бюджет"), -28)
+                .arg(m_budget > 0 ? megabytes(m_budget) + " MiB"
+                                  : QCoreApplication::translate("MemoryAccountant", "не ограничен"), 9);
+    return text;
+}
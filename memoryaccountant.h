@@ -0,0 +1,67 @@
+#ifndef MEMORYACCOUNTANT_H
+#define MEMORYACCOUNTANT_H
+
+#include <QString>
+#include <QVector>
+#include <functional>
+
+// Учёт памяти документа по категориям и соблюдение общего бюджета.
+// Владельцы данных регистрируют источники: функцию, сообщающую занятые
+// байты, и, для кэшей, функцию, освобождающую их. При превышении бюджета
+// кэши освобождаются в порядке категорий, начиная с самых дешёвых для
+// пересчёта; холст и история правок не освобождаются.
+class MemoryAccountant
+{
+public:
+    enum Category {
+        RegionCache,
+        PatternCache,
+        FillTemporaries,
+        CompositionCache,
+        Canvas,
+        History,
+        CategoryCount
+    };
+
+    using Probe = std::function<qint64()>;
+    // Возвращает число освобождённых байт
+    using Evictor = std::function<qint64()>;
+
+    static MemoryAccountant &instance();
+    static QString categoryName(Category category);
+
+    int addSource(Category category, const Probe &probe, const Evictor &evictor = Evictor());
+    void removeSource(int id);
+
+    qint64 bytes(Category category) const;
+    qint64 total() const;
+
+    // 0 — без ограничения
+    void setBudget(qint64 bytes) { m_budget = bytes; }
+    qint64 budget() const { return m_budget; }
+
+    // Освобождает кэши, пока сумма не уложится в бюджет; возвращает
+    // число освобождённых байт
+    qint64 enforceBudget();
+    // Освобождает все кэши независимо от бюджета
+    qint64 evictAll();
+
+    QString report() const;
+
+private:
+    MemoryAccountant();
+
+    struct Source
+    {
+        int id;
+        Category category;
+        Probe probe;
+        Evictor evictor;
+    };
+
+    QVector<Source> m_sources;
+    int m_nextId = 1;
+    qint64 m_budget = qint64(1024) * 1024 * 1024;
+};
+
+#endif // MEMORYACCOUNTANT_H
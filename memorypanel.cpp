@@ -0,0 +1,74 @@
+#include "memorypanel.h"
+#include "memoryaccountant.h"
+
+#include <QFontDatabase>
+#include <QFormLayout>
+#include <QLabel>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QTimer>
+#include <QVBoxLayout>
+
+MemoryPanel::MemoryPanel(QWidget *parent)
+    : QDialog(parent)
+    , m_report(new QLabel(this))
+    , m_budget(new QSpinBox(this))
+    , m_timer(new QTimer(this))
+{
+    setWindowTitle(tr("Память"));
+
+    m_report->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    m_report->setTextInteractionFlags(Qt::TextSelectableByMouse);
+
+    m_budget->setRange(0, 1024 * 1024);
+    m_budget->setSuffix(tr(" МиБ"));
+    m_budget->setSpecialValueText(tr("без ограничения"));
+    m_budget->setValue(int(MemoryAccountant::instance().budget() / (1024 * 1024)));
+    connect(m_budget, QOverload<int>::of(&QSpinBox::valueChanged), this, &MemoryPanel::setBudget);
+
+    QPushButton *evictButton = new QPushButton(tr("Освободить кэши"), this);
+    connect(evictButton, &QPushButton::clicked, this, &MemoryPanel::evictCaches);
+
+    QFormLayout *form = new QFormLayout;
+    form->addRow(tr("Бюджет:"), m_budget);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(m_report);
+    layout->addLayout(form);
+    layout->addWidget(evictButton);
+
+    m_timer->setInterval(1000);
+    connect(m_timer, &QTimer::timeout, this, &MemoryPanel::refresh);
+}
+
+void MemoryPanel::showEvent(QShowEvent *event)
+{
+    QDialog::showEvent(event);
+    refresh();
+    m_timer->start();
+}
+
+void MemoryPanel::hideEvent(QHideEvent *event)
+{
+    m_timer->stop();
+    QDialog::hideEvent(event);
+}
+
+void MemoryPanel::refresh()
+{
+    m_report->setText(MemoryAccountant::instance().report());
+}
+
+void MemoryPanel::setBudget(int megabytes)
+{
+    MemoryAccountant &accountant = MemoryAccountant::instance();
+    accountant.setBudget(qint64(megabytes) * 1024 * 1024);
+    accountant.enforceBudget();
+    refresh();
+}
+
+void MemoryPanel::evictCaches()
+{
+    MemoryAccountant::instance().evictAll();
+    refresh();
+}
@@ -0,0 +1,33 @@
+#ifndef MEMORYPANEL_H
+#define MEMORYPANEL_H
+
+#include <QDialog>
+
+class QLabel;
+class QSpinBox;
+class QTimer;
+
+// Окно диагностики памяти: занятые байты по категориям MemoryAccountant,
+// бюджет и ручное освобождение кэшей. Обновляется раз в секунду, пока открыто
+class MemoryPanel : public QDialog
+{
+    Q_OBJECT
+public:
+    explicit MemoryPanel(QWidget *parent = nullptr);
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private slots:
+    void refresh();
+    void setBudget(int megabytes);
+    void evictCaches();
+
+private:
+    QLabel *m_report;
+    QSpinBox *m_budget;
+    QTimer *m_timer;
+};
+
+#endif // MEMORYPANEL_H
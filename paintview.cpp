@@ -1,32 +1,140 @@
 #include "paintview.h"
 #include "penciltool.h"
 #include "hatchingtool.h"
+#include "layercommand.h"
+#include "startupprofile.h"
 
 #include <QMouseEvent>
 #include <QPainter>
 #include <QPaintEvent>
 #include <QResizeEvent>
 #include <QFileDialog>
+#include <QKeyEvent>
+#include <QLoggingCategory>
+#include <algorithm>
+#include <cstring>
+
+// Счётчики операций и замеры; по умолчанию выключены,
+// включаются через QT_LOGGING_RULES="draft.paintview.debug=true"
+Q_LOGGING_CATEGORY(lcPaintView, "draft.paintview", QtWarningMsg)
+
+namespace {
+
+const QSize MinimumCanvasSize(500, 500);
+
+} // namespace
 
 PaintView::PaintView(QWidget *parent)
     : QWidget(parent)
     , m_modified(false)
-    , m_image(500, 500, QImage::Format_ARGB32)
     , m_lastPoint(0, 0)
 {
     setAttribute(Qt::WA_StaticContents);
     setMouseTracking(true);
-
-    m_image.fill(Qt::white);
+    setFocusPolicy(Qt::StrongFocus);
 
     m_pencilTool = std::make_unique<PencilTool>();
     m_hatchingTool = std::make_unique<HatchingTool>();
+    for (Tool *tool : {static_cast<Tool *>(m_pencilTool.get()), static_cast<Tool *>(m_hatchingTool.get())})
+        tool->setWriteHandler([this](const QRect &rect) { saveOperationTiles(rect); });
+    connect(m_hatchingTool.get(), &HatchingTool::regionsMeasured, this, &PaintView::regionsMeasured);
 
     m_currentTool = m_pencilTool.get();
+
+    registerMemorySources();
+
+    m_undoStack.setUndoLimit(50);
+    connect(&m_undoStack, &QUndoStack::indexChanged, this, [this]() {
+        // Отмена могла убрать выбранные области
+        m_selectedHatches.erase(std::remove_if(m_selectedHatches.begin(), m_selectedHatches.end(), [this](int id) {
+            return std::none_of(m_hatchedRegions.cbegin(), m_hatchedRegions.cend(),
+                                [id](const HatchedRegion &entry) { return entry.id == id; });
+        }), m_selectedHatches.end());
+        m_modified = true;
+        update();
+    });
 }
 
 PaintView::~PaintView()
 {
+    for (int id : std::as_const(m_memorySources))
+        MemoryAccountant::instance().removeSource(id);
+}
+
+void PaintView::registerMemorySources()
+{
+    MemoryAccountant &accountant = MemoryAccountant::instance();
+    HatchingTool *hatching = m_hatchingTool.get();
+
+    m_memorySources.append(accountant.addSource(MemoryAccountant::Canvas, [this]() {
+        return m_layers.layerBytes();
+    }));
+    m_memorySources.append(accountant.addSource(MemoryAccountant::CompositionCache, [this]() {
+        return m_layers.cacheBytes();
+    }, [this]() {
+        const qint64 freed = m_layers.dropCaches();
+        update();
+        return freed;
+    }));
+    m_memorySources.append(accountant.addSource(MemoryAccountant::History, [this]() {
+        qint64 bytes = 0;
+        for (int i = 0; i < m_undoStack.count(); ++i) {
+            if (auto command = dynamic_cast<const LayerEditCommand *>(m_undoStack.command(i)))
+                bytes += command->bytes();
+        }
+        for (const HatchedRegion &entry : std::as_const(m_hatchedRegions))
+            bytes += qint64(entry.region.spans().size()) * qint64(sizeof(FillSpan));
+        return bytes;
+    }));
+    m_memorySources.append(accountant.addSource(MemoryAccountant::RegionCache, [hatching]() {
+        return hatching->regionCacheBytes();
+    }, [this, hatching]() {
+        update(hatching->clearPreview());
+        return hatching->dropRegionCache();
+    }));
+    m_patternCacheSource = accountant.addSource(MemoryAccountant::PatternCache, [hatching]() {
+        return hatching->patternCacheStats().bytes;
+    }, [hatching]() {
+        return hatching->dropPatternCache();
+    });
+    m_memorySources.append(m_patternCacheSource);
+    m_memorySources.append(accountant.addSource(MemoryAccountant::FillTemporaries, [hatching]() {
+        return hatching->fillMaskBytes();
+    }, [hatching]() {
+        return hatching->dropFillMask();
+    }));
+}
+
+void PaintView::setPatternCache(const std::shared_ptr<HatchPatternCache> &cache)
+{
+    m_hatchingTool->setPatternCache(cache);
+    if (m_patternCacheSource) {
+        MemoryAccountant::instance().removeSource(m_patternCacheSource);
+        m_memorySources.removeOne(m_patternCacheSource);
+        m_patternCacheSource = 0;
+    }
+}
+
+void PaintView::setActive(bool active)
+{
+    if (m_active == active)
+        return;
+    m_active = active;
+
+    if (active) {
+        m_layers.unpack();
+        growCanvas();
+        update();
+        return;
+    }
+
+    // Кэши инструмента пересобираются при первом действии после активации
+    m_hatchingTool->clearPreview();
+    m_hatchingTool->dropRegionCache();
+    m_hatchingTool->dropFillMask();
+    const qint64 freed = m_layers.pack();
+    qCDebug(lcPaintView) << "document packed:" << freed / 1024 << "KiB freed," << m_layers.layerBytes() / 1024
+             << "KiB of compressed tiles kept";
 }
 
 bool PaintView::openImage(const QString &fileName)
@@ -36,9 +144,32 @@ bool PaintView::openImage(const QString &fileName)
         return false;
 
     QSize newSize = loadedImage.size().expandedTo(size());
+    m_layers.clear();
     resizeImage(newSize);
-    m_image = loadedImage;
+
+    QPainter painter(&m_layers.image(LayerStack::ScanLayer));
+    painter.drawImage(QPoint(0, 0), loadedImage);
+    painter.end();
+
+    m_lastScanStats = ScanProcessor::Stats();
+    const QImage outline = m_scanProcessing
+                               ? ScanProcessor(m_scanOptions).process(loadedImage, &m_lastScanStats)
+                               : loadedImage;
+    painter.begin(&m_layers.image(LayerStack::ScanOutlineLayer));
+    painter.drawImage(QPoint(0, 0), outline);
+    painter.end();
+    if (m_scanProcessing) {
+        qCDebug(lcPaintView) << "scan processing:" << loadedImage.size()
+                 << m_lastScanStats.nsecs / 1000000.0 << "ms,"
+                 << m_lastScanStats.megapixelsPerSecond << "MP/s";
+    }
+
+    m_layers.markAllDirty();
+    m_undoStack.clear();
+    m_hatchedRegions.clear();
+    m_selectedHatches.clear();
     m_modified = false;
+    MemoryAccountant::instance().enforceBudget();
     update();
 
     return true;
@@ -46,11 +177,12 @@ bool PaintView::openImage(const QString &fileName)
 
 bool PaintView::saveImage(const QString &fileName, const char *fileFormat)
 {
-    QImage visibleImage = m_image;
-    resizeImage(size());
+    ensureCanvas();
+    QImage visibleImage = m_layers.flatten();
 
     if (visibleImage.save(fileName, fileFormat)) {
         m_modified = false;
+        m_undoStack.setClean();
         return true;
     }
     return false;
@@ -58,7 +190,11 @@ bool PaintView::saveImage(const QString &fileName, const char *fileFormat)
 
 void PaintView::clearImage()
 {
-    m_image.fill(Qt::white);
+    ensureCanvas();
+    m_layers.clear();
+    m_undoStack.clear();
+    m_hatchedRegions.clear();
+    m_selectedHatches.clear();
     m_modified = true;
     update();
 }
@@ -66,7 +202,9 @@ void PaintView::clearImage()
 void PaintView::setCurrentTool(Tool *tool)
 {
     if (tool && tool != m_currentTool) {
-        if (m_currentTool) {
+        if (m_currentTool == m_hatchingTool.get()) {
+            update(m_hatchingTool->clearPreview());
+            clearHatchSelection();
         }
 
         m_currentTool = tool;
@@ -96,6 +234,11 @@ void PaintView::setPenWidth(int width)
     if (m_hatchingTool) m_hatchingTool->setPenWidth(width);
 }
 
+void PaintView::setStrokeSmoothing(bool enabled)
+{
+    if (m_pencilTool) m_pencilTool->setSmoothing(enabled);
+}
+
 QColor PaintView::penColor() const
 {
     return m_currentTool ? m_currentTool->penColor() : Qt::blue;
@@ -110,6 +253,7 @@ void PaintView::setHatchAngle(int angle)
 {
     if (m_hatchingTool) {
         m_hatchingTool->setHatchAngle(angle);
+        rehatchSelection([angle](HatchPattern &pattern) { pattern.angle = angle; });
     }
 }
 
@@ -117,6 +261,9 @@ void PaintView::setHatchSpacing(int spacing)
 {
     if (m_hatchingTool) {
         m_hatchingTool->setHatchSpacing(spacing);
+        // Шаг берётся у инструмента, уже в пределах HatchPattern::MaxSpacing
+        const int bounded = m_hatchingTool->getHatchSpacing();
+        rehatchSelection([bounded](HatchPattern &pattern) { pattern.spacing = bounded; });
     }
 }
 
@@ -124,6 +271,7 @@ void PaintView::setCrossHatching(bool cross)
 {
     if (m_hatchingTool) {
         m_hatchingTool->setCrossHatching(cross);
+        rehatchSelection([cross](HatchPattern &pattern) { pattern.cross = cross; });
     }
 }
 
@@ -131,21 +279,192 @@ void PaintView::setHatchType(HatchingTool::HatchType type)
 {
     if (m_hatchingTool) {
         m_hatchingTool->setHatchType(type);
+        // Материал задаёт рисунок целиком; цвет и толщина остаются у области
+        const HatchPattern preset = m_hatchingTool->currentPattern();
+        rehatchSelection([&preset](HatchPattern &pattern) {
+            pattern.type = preset.type;
+            pattern.family = preset.family;
+            pattern.angle = preset.angle;
+            pattern.spacing = preset.spacing;
+            pattern.cross = preset.cross;
+        });
+    }
+}
+
+void PaintView::rehatchSelection(const std::function<void(HatchPattern &)> &edit)
+{
+    if (m_currentTool != m_hatchingTool.get() || m_selectedHatches.isEmpty())
+        return;
+
+    const QVector<HatchedRegion> before = m_hatchedRegions;
+    QVector<HatchedRegion> changed;
+    for (HatchedRegion &entry : m_hatchedRegions) {
+        if (!m_selectedHatches.contains(entry.id))
+            continue;
+        const quint64 key = entry.pattern.key();
+        edit(entry.pattern);
+        if (entry.pattern.key() != key)
+            changed.append(entry);
+    }
+    if (changed.isEmpty())
+        return;
+
+    // Для отмены сохраняется только охватывающий прямоугольник областей
+    QRect rect;
+    for (const HatchedRegion &entry : std::as_const(changed))
+        rect |= entry.region.boundingRect();
+    QImage &layer = m_layers.image(LayerStack::HatchLayer);
+    const QImage pixelsBefore = layer.copy(rect);
+    m_hatchingTool->renderRegions(changed, layer);
+
+    m_undoStack.push(new HatchEditCommand(&m_layers, rect, pixelsBefore, layer.copy(rect),
+                                          &m_hatchedRegions, before, m_hatchedRegions,
+                                          tr("Изменение штриховки")));
+    m_layers.markDirty(LayerStack::HatchLayer, rect);
+    m_modified = true;
+    emit imageModified();
+    update(rect);
+}
+
+void PaintView::recordHatchedRegions(const QVector<HatchedRegion> &applied)
+{
+    // Новая штриховка перекрывает старую: области, которых она коснулась,
+    // больше нельзя перерисовать без порчи новых пикселей. Новые области не
+    // выбираются: параметры, выбранные для следующей штриховки, не должны
+    // менять уже заштрихованное. Области одной операции друг друга не
+    // вытесняют: соседние по сглаженному краю делят его пиксели, но
+    // заштрихованы одним рисунком
+    m_selectedHatches.clear();
+    int previous = m_hatchedRegions.size();
+    for (HatchedRegion entry : applied) {
+        for (int i = previous - 1; i >= 0; --i) {
+            if (m_hatchedRegions[i].region.intersects(entry.region)) {
+                m_hatchedRegions.removeAt(i);
+                --previous;
+            }
+        }
+        entry.id = m_nextHatchId++;
+        m_hatchedRegions.append(entry);
+    }
+}
+
+void PaintView::selectHatchAt(const QPoint &point)
+{
+    const QRect before = hatchSelectionRect();
+    m_selectedHatches.clear();
+    for (const HatchedRegion &entry : std::as_const(m_hatchedRegions)) {
+        if (entry.region.contains(point)) {
+            m_selectedHatches.append(entry.id);
+            // Рисунок инструмента — как у выбранной области целиком: диалоги
+            // угла и шага начинаются с её параметров, а правка не меняет
+            // материал и семейство линий
+            m_hatchingTool->setPattern(entry.pattern);
+            emit hatchSettingsChanged();
+            break;
+        }
+    }
+    update((before | hatchSelectionRect()).adjusted(-2, -2, 2, 2));
+}
+
+void PaintView::clearHatchSelection()
+{
+    const QRect before = hatchSelectionRect();
+    m_selectedHatches.clear();
+    update(before.adjusted(-2, -2, 2, 2));
+}
+
+QRect PaintView::hatchSelectionRect() const
+{
+    QRect rect;
+    for (const HatchedRegion &entry : m_hatchedRegions) {
+        if (m_selectedHatches.contains(entry.id))
+            rect |= entry.region.boundingRect();
     }
+    return rect;
+}
+
+void PaintView::setAntialiasAwareFill(bool enabled)
+{
+    if (m_hatchingTool) {
+        update(m_hatchingTool->clearPreview());
+        m_hatchingTool->setFillMode(enabled ? FillMask::AntialiasAware : FillMask::ExactMatch);
+    }
+}
+
+int PaintView::hatchSeeds(const QVector<QPoint> &seeds)
+{
+    ensureCanvas();
+    useHatchingTool();
+    syncBoundary();
+    beginOperation();
+    const int regions = m_hatchingTool->hatchSeeds(seeds, m_layers.image(LayerStack::HatchLayer));
+    commitToolChanges();
+    endOperation();
+    return regions;
+}
+
+void PaintView::drawStroke(const QVector<QPoint> &points)
+{
+    if (points.isEmpty())
+        return;
+    usePencilTool();
+
+    // Тот же путь, что у мыши; время событий растёт равномерно, чтобы
+    // сглаживание штриха было воспроизводимым
+    ulong timestamp = 0;
+    auto send = [&](QEvent::Type type, const QPoint &point, Qt::MouseButtons buttons) {
+        const Qt::MouseButton button = type == QEvent::MouseMove ? Qt::NoButton : Qt::LeftButton;
+        QMouseEvent event(type, QPointF(point), QPointF(point), button, buttons, Qt::NoModifier);
+        timestamp += 8;
+        event.setTimestamp(timestamp);
+        switch (type) {
+        case QEvent::MouseButtonPress: mousePressEvent(&event); break;
+        case QEvent::MouseMove: mouseMoveEvent(&event); break;
+        default: mouseReleaseEvent(&event); break;
+        }
+    };
+
+    send(QEvent::MouseButtonPress, points.first(), Qt::LeftButton);
+    for (int i = 1; i < points.size(); ++i)
+        send(QEvent::MouseMove, points[i], Qt::LeftButton);
+    send(QEvent::MouseButtonRelease, points.last(), Qt::NoButton);
+}
+
+void PaintView::setLayerVisible(LayerStack::LayerId id, bool visible)
+{
+    m_layers.setVisible(id, visible);
+    update();
+}
+
+void PaintView::setLayerOpacity(LayerStack::LayerId id, qreal opacity)
+{
+    m_layers.setOpacity(id, opacity);
+    update();
 }
 
 void PaintView::mousePressEvent(QMouseEvent *event)
 {
     if (!m_currentTool) return;
 
+    ensureCanvas();
+    if (m_currentTool == m_hatchingTool.get() && (event->modifiers() & Qt::AltModifier)) {
+        if (event->button() == Qt::LeftButton)
+            selectHatchAt(event->pos());
+        return;
+    }
+
     m_lastPoint = event->pos();
-    QPainter painter(&m_image);
+    syncBoundary();
+    if (event->button() == Qt::LeftButton)
+        beginOperation();
+
+    QPainter painter(&m_layers.image(m_currentTool->targetLayer()));
     painter.setRenderHint(QPainter::Antialiasing, true);
 
     m_currentTool->onMousePress(event, painter, m_lastPoint);
+    painter.end();
 
-    m_modified = true;
-    update();
+    commitToolChanges();
 }
 
 void PaintView::mouseMoveEvent(QMouseEvent *event)
@@ -153,14 +472,24 @@ void PaintView::mouseMoveEvent(QMouseEvent *event)
     if (!m_currentTool) return;
 
     if (event->buttons() & Qt::LeftButton) {
-        QPainter painter(&m_image);
+        ensureCanvas();
+        QPainter painter(&m_layers.image(m_currentTool->targetLayer()));
         painter.setRenderHint(QPainter::Antialiasing, true);
 
+        const QRect selectionBefore = m_hatchingTool->selectionRect();
         m_currentTool->onMouseMove(event, painter, m_lastPoint);
+        painter.end();
 
         m_lastPoint = event->pos();
-        m_modified = true;
-        update();
+        commitToolChanges();
+
+        const QRect selection = selectionBefore | m_hatchingTool->selectionRect();
+        if (!selection.isEmpty())
+            update(selection.adjusted(-1, -1, 1, 1));
+    } else if (m_currentTool == m_hatchingTool.get() && !m_layers.size().isEmpty()) {
+        // На пустом листе до первой правки предпросматривать нечего
+        syncBoundary();
+        update(m_hatchingTool->updatePreview(event->pos()));
     }
 }
 
@@ -168,44 +497,275 @@ void PaintView::mouseReleaseEvent(QMouseEvent *event)
 {
     if (!m_currentTool) return;
 
-    QPainter painter(&m_image);
+    ensureCanvas();
+    syncBoundary();
+
+    QPainter painter(&m_layers.image(m_currentTool->targetLayer()));
     painter.setRenderHint(QPainter::Antialiasing, true);
 
+    const int queuedBefore = m_hatchingTool->queuedSeeds().size();
+    const QRect selectionBefore = m_hatchingTool->selectionRect();
     m_currentTool->onMouseRelease(event, painter, m_lastPoint);
+    painter.end();
+
+    commitToolChanges();
+    if (event->button() == Qt::LeftButton)
+        endOperation();
+
+    if (queuedBefore != m_hatchingTool->queuedSeeds().size())
+        update();
+    if (!selectionBefore.isEmpty())
+        update(selectionBefore.adjusted(-1, -1, 1, 1));
+}
+
+void PaintView::keyPressEvent(QKeyEvent *event)
+{
+    if (event->key() == Qt::Key_Escape && m_currentTool == m_hatchingTool.get()
+        && m_hatchingTool->queuedSeeds().isEmpty() && !m_selectedHatches.isEmpty()) {
+        clearHatchSelection();
+        return;
+    }
+
+    if (m_currentTool != m_hatchingTool.get() || m_hatchingTool->queuedSeeds().isEmpty()) {
+        QWidget::keyPressEvent(event);
+        return;
+    }
+
+    switch (event->key()) {
+    case Qt::Key_Return:
+    case Qt::Key_Enter: {
+        syncBoundary();
+        beginOperation();
+        m_hatchingTool->commitQueue(m_layers.image(LayerStack::HatchLayer));
+        commitToolChanges();
+        endOperation();
+        update();
+        break;
+    }
+    case Qt::Key_Escape:
+        m_hatchingTool->clearQueue();
+        update();
+        break;
+    default:
+        QWidget::keyPressEvent(event);
+    }
+}
+
+void PaintView::beginOperation()
+{
+    m_operationActive = true;
+    m_operationLayer = m_currentTool->targetLayer();
+    // Слой не копируется целиком: инструмент сообщает, куда будет писать,
+    // и до записи сохраняются только затронутые тайлы (saveOperationTiles)
+    m_operationTiles.clear();
+    m_operationRect = QRect();
+    m_operationCounters = Arena::counters();
+}
+
+void PaintView::saveOperationTiles(const QRect &rect)
+{
+    if (!m_operationActive)
+        return;
+
+    const QImage &layer = m_layers.image(m_operationLayer);
+    const QRect area = rect.intersected(layer.rect());
+    if (area.isEmpty())
+        return;
+
+    const int size = LayerStack::TileSize;
+    for (int row = area.top() / size; row <= area.bottom() / size; ++row) {
+        for (int column = area.left() / size; column <= area.right() / size; ++column) {
+            const quint64 key = (quint64(row) << 32) | quint64(column);
+            if (!m_operationTiles.contains(key))
+                m_operationTiles.insert(key, layer.copy(column * size, row * size, size, size));
+        }
+    }
+}
+
+QImage PaintView::operationBefore(const QRect &rect) const
+{
+    // Пиксели вне сохранённых тайлов операция не меняла
+    QImage before = m_layers.image(m_operationLayer).copy(rect);
+    const int size = LayerStack::TileSize;
+    for (auto it = m_operationTiles.cbegin(); it != m_operationTiles.cend(); ++it) {
+        const int row = int(it.key() >> 32);
+        const int column = int(it.key() & 0xffffffffu);
+        const QRect tileRect(column * size, row * size, size, size);
+        const QRect area = tileRect.intersected(rect);
+        if (area.isEmpty())
+            continue;
+        const size_t rowBytes = size_t(area.width()) * sizeof(QRgb);
+        for (int y = area.top(); y <= area.bottom(); ++y) {
+            const uchar *src = it.value().constScanLine(y - tileRect.top())
+                               + (area.left() - tileRect.left()) * sizeof(QRgb);
+            uchar *dst = before.scanLine(y - rect.top()) + (area.left() - rect.left()) * sizeof(QRgb);
+            std::memcpy(dst, src, rowBytes);
+        }
+    }
+    return before;
+}
+
+void PaintView::endOperation()
+{
+    if (!m_operationActive)
+        return;
+
+    const QVector<HatchedRegion> applied = m_hatchingTool->takeAppliedRegions();
+    if (!m_operationRect.isEmpty() && !applied.isEmpty()) {
+        const QVector<HatchedRegion> regionsBefore = m_hatchedRegions;
+        const QRect selectionBefore = hatchSelectionRect();
+        recordHatchedRegions(applied);
+        update((selectionBefore | hatchSelectionRect()).adjusted(-2, -2, 2, 2));
+        m_undoStack.push(new HatchEditCommand(&m_layers, m_operationRect,
+                                              operationBefore(m_operationRect),
+                                              m_layers.image(m_operationLayer).copy(m_operationRect),
+                                              &m_hatchedRegions, regionsBefore, m_hatchedRegions,
+                                              tr("Штриховка")));
+    } else if (!m_operationRect.isEmpty()) {
+        const QString text = m_operationLayer == LayerStack::HatchLayer ? tr("Штриховка") : tr("Штрих");
+        m_undoStack.push(new LayerEditCommand(&m_layers, m_operationLayer, m_operationRect,
+                                              operationBefore(m_operationRect),
+                                              m_layers.image(m_operationLayer).copy(m_operationRect),
+                                              text));
+    }
 
+    const Arena::Counters counters = Arena::counters();
+    qCDebug(lcPaintView) << "operation:" << counters.requests - m_operationCounters.requests << "arena requests,"
+             << counters.systemAllocations - m_operationCounters.systemAllocations
+             << "arena blocks allocated";
+
+    // Временные данные операции больше не нужны; блоки арены остаются
+    Arena::local().reset();
+    MemoryAccountant::instance().enforceBudget();
+
+    m_operationActive = false;
+    m_operationTiles.clear();
+    m_operationRect = QRect();
+}
+
+void PaintView::leaveEvent(QEvent *event)
+{
+    QWidget::leaveEvent(event);
+    update(m_hatchingTool->clearPreview());
+}
+
+void PaintView::syncBoundary()
+{
+    if (m_currentTool == m_hatchingTool.get())
+        m_hatchingTool->setBoundaryImage(&m_layers.boundary(), m_layers.boundaryRevision());
+}
+
+void PaintView::commitToolChanges()
+{
+    const QRect dirtyRect = m_currentTool->takeDirtyRect();
+    if (dirtyRect.isEmpty())
+        return;
+
+    m_layers.markDirty(m_currentTool->targetLayer(), dirtyRect);
+    if (m_operationActive)
+        m_operationRect |= dirtyRect;
     m_modified = true;
-    update();
+    emit imageModified();
+    update(dirtyRect);
 }
 
 void PaintView::paintEvent(QPaintEvent *event)
 {
     QPainter painter(this);
     QRect dirtyRect = event->rect();
-    painter.drawImage(dirtyRect, m_image, dirtyRect);
+
+    // До первой правки или открытия файла слоёв нет: лист рисуется белым,
+    // как пустой слой скана
+    if (m_layers.size().isEmpty()) {
+        painter.fillRect(dirtyRect, Qt::white);
+        notifyFirstPaint();
+        return;
+    }
+
+    m_layers.unpack();
+    painter.drawImage(dirtyRect, m_layers.composite(dirtyRect), dirtyRect);
+
+    // Предпросмотр штриховки рисуется поверх композиции, не меняя слоёв
+    if (m_currentTool == m_hatchingTool.get() && m_hatchingTool->previewRect().intersects(dirtyRect)) {
+        const QRect previewRect = m_hatchingTool->previewRect();
+        const QRect area = previewRect.intersected(dirtyRect);
+        painter.drawImage(area, m_hatchingTool->previewImage(), area.translated(-previewRect.topLeft()));
+    }
+
+    // Очередь пакетной штриховки и рамка выделения
+    if (m_currentTool == m_hatchingTool.get()) {
+        painter.setRenderHint(QPainter::Antialiasing, true);
+        painter.setPen(QPen(m_hatchingTool->penColor(), 1));
+        for (const QPoint &seed : m_hatchingTool->queuedSeeds())
+            painter.drawEllipse(seed, 4, 4);
+
+        if (!m_hatchingTool->selectionRect().isEmpty()) {
+            painter.setPen(QPen(m_hatchingTool->penColor(), 1, Qt::DashLine));
+            painter.drawRect(m_hatchingTool->selectionRect());
+        }
+
+        // Области, которые перерисуются при смене параметров штриховки
+        painter.setPen(QPen(m_hatchingTool->penColor(), 1, Qt::DotLine));
+        for (const HatchedRegion &entry : std::as_const(m_hatchedRegions)) {
+            if (m_selectedHatches.contains(entry.id))
+                painter.drawRect(entry.region.boundingRect().adjusted(-1, -1, 1, 1));
+        }
+    }
+
+    notifyFirstPaint();
+}
+
+void PaintView::notifyFirstPaint()
+{
+    // Отметка нужна только для первой отрисовки
+    if (!m_painted) {
+        m_painted = true;
+        StartupProfile::firstPaint();
+    }
 }
 
 void PaintView::resizeEvent(QResizeEvent *event)
 {
     QWidget::resizeEvent(event);
 
-    if (width() > m_image.width() || height() > m_image.height()) {
-        int newWidth = qMax(width() + 128, m_image.width());
-        int newHeight = qMax(height() + 128, m_image.height());
+    // Неактивный документ сжат; холст подгоняется при активации
+    if (m_active)
+        growCanvas();
+}
+
+void PaintView::growCanvas()
+{
+    if (m_layers.size().isEmpty())
+        return;
+
+    if (width() > m_layers.size().width() || height() > m_layers.size().height()) {
+        int newWidth = qMax(width() + 128, m_layers.size().width());
+        int newHeight = qMax(height() + 128, m_layers.size().height());
         resizeImage(QSize(newWidth, newHeight));
     }
 }
 
-void PaintView::resizeImage(const QSize &newSize)
+void PaintView::ensureCanvas()
 {
-    if (m_image.size() == newSize)
+    // Слои выделяются при первой правке или открытии файла, а не в
+    // конструкторе и не при первой отрисовке: пустой лист рисуется белым,
+    // и окно появляется без заполнения мегабайтов пикселей
+    if (!m_layers.size().isEmpty()) {
+        m_layers.unpack();
         return;
+    }
 
-    QImage newImage(newSize, QImage::Format_ARGB32);
-    newImage.fill(Qt::white);
+    QSize initialSize = MinimumCanvasSize;
+    if (width() > initialSize.width() || height() > initialSize.height())
+        initialSize = QSize(qMax(width() + 128, initialSize.width()), qMax(height() + 128, initialSize.height()));
+    m_layers.resize(initialSize);
+}
 
-    QPainter painter(&newImage);
-    painter.drawImage(QPoint(0, 0), m_image);
-    m_image = newImage;
+void PaintView::resizeImage(const QSize &newSize)
+{
+    if (m_layers.size() == newSize)
+        return;
 
+    m_layers.resize(newSize);
     update();
 }
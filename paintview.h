@@ -4,12 +4,19 @@
 #include <QWidget>
 #include <QImage>
 #include <QColor>
+#include <QHash>
 #include <QPoint>
+#include <QUndoStack>
+#include <functional>
 #include <memory>
 
 class Tool;
 class PencilTool;
 #include "hatchingtool.h"
+#include "arena.h"
+#include "layerstack.h"
+#include "memoryaccountant.h"
+#include "scanprocessor.h"
 
 class PaintView : public QWidget
 {
@@ -31,35 +38,125 @@ public:
 
     void setPenColor(const QColor &color);
     void setPenWidth(int width);
+    void setStrokeSmoothing(bool enabled);
 
+    // Параметры штриховки применяются к следующим заливкам и, если инструмент
+    // штриховки активен, перерисовывают выбранные заштрихованные области
     void setHatchAngle(int angle);
     void setHatchSpacing(int spacing);
     void setCrossHatching(bool cross);
     void setHatchType(HatchingTool::HatchType type);
+    void setAntialiasAwareFill(bool enabled);
+
+    // Общий для нескольких документов кэш плиток штриховки; его память
+    // учитывает владелец, а не документ
+    void setPatternCache(const std::shared_ptr<HatchPatternCache> &cache);
+    // Неактивный документ (вкладка в фоне) освобождает кэши и хранит слои
+    // сжатыми; при активации слои распаковываются
+    void setActive(bool active);
+    bool isActive() const { return m_active; }
+    int hatchAngle() const { return m_hatchingTool->getHatchAngle(); }
+    int hatchSpacing() const { return m_hatchingTool->getHatchSpacing(); }
+    bool isCrossHatching() const { return m_hatchingTool->isCrossHatching(); }
+    HatchingTool::HatchType hatchType() const { return m_hatchingTool->getHatchType(); }
+
+    // Действия без событий от пользователя (сценарии, RenderService).
+    // Каждое — одна отменяемая операция, как соответствующий жест мышью
+    int hatchSeeds(const QVector<QPoint> &seeds);
+    // Заштрихованные области документа. Область выбирается только
+    // Alt+кликом, Esc и новая штриховка снимают выбор
+    const QVector<HatchedRegion> &hatchedRegions() const { return m_hatchedRegions; }
+    QVector<int> selectedHatches() const { return m_selectedHatches; }
+    void selectHatchAt(const QPoint &point);
+    void clearHatchSelection();
+    void drawStroke(const QVector<QPoint> &points);
+
+    // Измерения последней штриховки и их единицы (см. HatchingTool::Measurement)
+    void setMeasurementScale(qreal dpi, qreal scale) { m_hatchingTool->setMeasurementScale(dpi, scale); }
+    qreal measurementDpi() const { return m_hatchingTool->measurementDpi(); }
+    qreal measurementScale() const { return m_hatchingTool->measurementScale(); }
+    const HatchingTool::Measurement &lastMeasurement() const { return m_hatchingTool->lastMeasurement(); }
+    HatchPatternCache::Stats patternCacheStats() const { return m_hatchingTool->patternCacheStats(); }
+
+    // Очистка скана при открытии; без неё контурами служит сам скан
+    void setScanProcessing(bool enabled) { m_scanProcessing = enabled; }
+    void setScanThinning(bool enabled) { m_scanOptions.thinning = enabled; }
+    const ScanProcessor::Stats &lastScanStats() const { return m_lastScanStats; }
+
+    QString layerName(LayerStack::LayerId id) const { return m_layers.name(id); }
+    bool isLayerVisible(LayerStack::LayerId id) const { return m_layers.isVisible(id); }
+    qreal layerOpacity(LayerStack::LayerId id) const { return m_layers.opacity(id); }
+    void setLayerVisible(LayerStack::LayerId id, bool visible);
+    void setLayerOpacity(LayerStack::LayerId id, qreal opacity);
+
+    QUndoStack *undoStack() { return &m_undoStack; }
 
     bool isModified() const { return m_modified; }
     QColor penColor() const;
     int penWidth() const;
-    const QImage& image() const { return m_image; }
+    QImage image() { ensureCanvas(); return m_layers.flatten(); }
+    const LayerStack &layers() const { return m_layers; }
 
 signals:
     void toolChanged(Tool *newTool);
     void imageModified();
+    void regionsMeasured();
+    // Параметры штриховки взяты из выбранной области
+    void hatchSettingsChanged();
 
 protected:
     void mousePressEvent(QMouseEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
     void mouseReleaseEvent(QMouseEvent *event) override;
+    void leaveEvent(QEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
     void paintEvent(QPaintEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
 
 private:
     void resizeImage(const QSize &newSize);
+    void ensureCanvas();
+    void notifyFirstPaint();
+    void growCanvas();
+    void registerMemorySources();
+    void commitToolChanges();
+    void syncBoundary();
+    void recordHatchedRegions(const QVector<HatchedRegion> &applied);
+    void rehatchSelection(const std::function<void(HatchPattern &)> &edit);
+    QRect hatchSelectionRect() const;
+
+    // Изменения инструмента от нажатия до отпускания — одна отменяемая операция
+    void beginOperation();
+    void endOperation();
+    void saveOperationTiles(const QRect &rect);
+    QImage operationBefore(const QRect &rect) const;
 
     bool m_modified = false;
-    QImage m_image;
+    bool m_scanProcessing = true;
+    ScanProcessor::Options m_scanOptions;
+    ScanProcessor::Stats m_lastScanStats;
+    LayerStack m_layers;
+    QUndoStack m_undoStack;
+
+    bool m_operationActive = false;
+    LayerStack::LayerId m_operationLayer = LayerStack::OutlineLayer;
+    // Тайлы слоя до операции, по ключу (строка << 32) | столбец; тайл
+    // копируется перед первой записью инструмента в него
+    QHash<quint64, QImage> m_operationTiles;
+    QRect m_operationRect;
+    Arena::Counters m_operationCounters;
     QPoint m_lastPoint;
 
+    QVector<int> m_memorySources;
+    int m_patternCacheSource = 0;
+    bool m_active = true;
+    bool m_painted = false;
+
+    // Заштрихованные области и выбранные из них (по id)
+    QVector<HatchedRegion> m_hatchedRegions;
+    QVector<int> m_selectedHatches;
+    int m_nextHatchId = 1;
+
     Tool *m_currentTool = nullptr;
     std::unique_ptr<PencilTool> m_pencilTool;
     std::unique_ptr<HatchingTool> m_hatchingTool;
@@ -0,0 +1,35 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <QAtomicInt>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <functional>
+
+// Выполняет body(i) для всех i из [0, count) на пуле потоков и ждёт
+// завершения. Индексы разбираются по одному, вызывающий поток тоже работает.
+inline void parallelFor(int count, const std::function<void(int)> &body,
+                        QThreadPool *pool = QThreadPool::globalInstance())
+{
+    if (count <= 0)
+        return;
+
+    QAtomicInt next(0);
+    auto worker = [&]() {
+        for (int i = next.fetchAndAddRelaxed(1); i < count; i = next.fetchAndAddRelaxed(1))
+            body(i);
+    };
+
+    const int helpers = qMin(count - 1, qMax(0, pool->maxThreadCount() - 1));
+    QSemaphore done;
+    for (int i = 0; i < helpers; ++i) {
+        pool->start([&worker, &done]() {
+            worker();
+            done.release();
+        });
+    }
+    worker();
+    done.acquire(helpers);
+}
+
+#endif // PARALLEL_H
@@ -1,6 +1,12 @@
 #include "penciltool.h"
+#include "strokerasterizer.h"
 #include <QPainter>
 #include <QMouseEvent>
+#include <QLoggingCategory>
+
+// Статистика упрощения штрихов; по умолчанию выключена,
+// включается через QT_LOGGING_RULES="draft.pencil.debug=true"
+Q_LOGGING_CATEGORY(lcPencil, "draft.pencil", QtWarningMsg)
 
 PencilTool::PencilTool(QObject *parent) : Tool(parent)
 {
@@ -11,10 +17,20 @@ void PencilTool::onMousePress(QMouseEvent *event, QPainter &painter, const QPoin
     Q_UNUSED(lastPoint);
     if (event->button() == Qt::LeftButton) {
         m_scribbling = true;
-        m_lastPoint = event->pos();
+        m_lastPoint = m_processor.begin(event->pos(), event->timestamp());
+        aboutToWrite(segmentBounds(m_lastPoint, m_lastPoint));
+
+        if (StrokeRasterizer::canRasterize(painter)) {
+            StrokeRasterizer rasterizer(*static_cast<QImage *>(painter.device()));
+            rasterizer.setColor(m_penColor);
+            rasterizer.setWidth(m_penWidth);
+            addDirtyRect(rasterizer.drawPoint(m_lastPoint));
+            return;
+        }
 
         painter.setPen(QPen(m_penColor, m_penWidth, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
         painter.drawPoint(m_lastPoint);
+        addDirtyRect(segmentBounds(m_lastPoint, m_lastPoint));
     }
 }
 
@@ -22,8 +38,11 @@ void PencilTool::onMouseMove(QMouseEvent *event, QPainter &painter, const QPoint
 {
     Q_UNUSED(lastPoint);
     if ((event->buttons() & Qt::LeftButton) && m_scribbling) {
-        drawLineTo(event->pos(), painter, m_lastPoint);
-        m_lastPoint = event->pos();
+        QPointF vertex;
+        if (m_processor.addPoint(event->pos(), event->timestamp(), vertex)) {
+            drawLineTo(vertex, painter, m_lastPoint);
+            m_lastPoint = vertex;
+        }
     }
 }
 
@@ -31,13 +50,39 @@ void PencilTool::onMouseRelease(QMouseEvent *event, QPainter &painter, const QPo
 {
     Q_UNUSED(lastPoint);
     if (event->button() == Qt::LeftButton && m_scribbling) {
-        drawLineTo(event->pos(), painter, m_lastPoint);
+        QPointF vertex;
+        if (m_processor.addPoint(event->pos(), event->timestamp(), vertex)) {
+            drawLineTo(vertex, painter, m_lastPoint);
+            m_lastPoint = vertex;
+        }
+        if (m_processor.finish(vertex))
+            drawLineTo(vertex, painter, m_lastPoint);
         m_scribbling = false;
+
+        qCDebug(lcPencil) << "PencilTool:" << m_processor.inputCount() << "points ->"
+                 << m_processor.points().size() << "vertices";
     }
 }
 
-void PencilTool::drawLineTo(const QPoint &endPoint, QPainter &painter, const QPoint &startPoint)
+void PencilTool::drawLineTo(const QPointF &endPoint, QPainter &painter, const QPointF &startPoint)
 {
+    // Поле segmentBounds шире следа растеризатора и QPainter
+    aboutToWrite(segmentBounds(startPoint, endPoint));
+    if (StrokeRasterizer::canRasterize(painter)) {
+        StrokeRasterizer rasterizer(*static_cast<QImage *>(painter.device()));
+        rasterizer.setColor(m_penColor);
+        rasterizer.setWidth(m_penWidth);
+        addDirtyRect(rasterizer.drawSegment(startPoint, endPoint));
+        return;
+    }
+
     painter.setPen(QPen(m_penColor, m_penWidth, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
     painter.drawLine(startPoint, endPoint);
+    addDirtyRect(segmentBounds(startPoint, endPoint));
+}
+
+QRect PencilTool::segmentBounds(const QPointF &from, const QPointF &to) const
+{
+    const qreal margin = m_penWidth / 2.0 + 1;
+    return QRectF(from, to).normalized().adjusted(-margin, -margin, margin, margin).toAlignedRect();
 }
@@ -2,6 +2,7 @@
 #define PENCILTOOL_H
 
 #include "tool.h"
+#include "strokeprocessor.h"
 
 class PencilTool : public Tool
 {
@@ -13,11 +14,18 @@ public:
     void onMouseMove(QMouseEvent *event, QPainter &painter, const QPoint &lastPoint) override;
     void onMouseRelease(QMouseEvent *event, QPainter &painter, const QPoint &lastPoint) override;
 
+    void setSmoothing(bool enabled) { m_processor.setSmoothing(enabled); }
+
+    // Вершины последнего штриха после сглаживания и упрощения
+    const QVector<QPointF> &strokePoints() const { return m_processor.points(); }
+
 private:
-    void drawLineTo(const QPoint &endPoint, QPainter &painter, const QPoint &startPoint);
+    void drawLineTo(const QPointF &endPoint, QPainter &painter, const QPointF &startPoint);
+    QRect segmentBounds(const QPointF &from, const QPointF &to) const;
 
     bool m_scribbling = false;
-    QPoint m_lastPoint;
+    QPointF m_lastPoint;
+    StrokeProcessor m_processor;
 };
 
 #endif // PENCILTOOL_H
@@ -0,0 +1,252 @@
+#include "renderservice.h"
+#include "hatchpatterncache.h"
+#include "memoryaccountant.h"
+#include "paintview.h"
+
+#include <QDebug>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QVector>
+
+namespace {
+
+// Пределы те же, что в диалогах MainWindow: толщина пера 1–50. Координаты
+// ограничены, чтобы точка не переполняла арифметику QPoint при рисовании
+const int MinPenWidth = 1;
+const int MaxPenWidth = 50;
+const int MaxCoordinate = 1 << 16;
+
+// Имена материалов в порядке HatchingTool::HatchType
+const char *const HatchTypeNames[] = {
+    "metal", "nonmetal", "wood", "stone", "ceramic", "concrete", "glass", "liquid", "soil"
+};
+
+bool parseHatchType(const QByteArray &name, HatchingTool::HatchType *type)
+{
+    for (int i = 0; i < int(sizeof(HatchTypeNames) / sizeof(HatchTypeNames[0])); ++i) {
+        if (name == HatchTypeNames[i]) {
+            *type = HatchingTool::HatchType(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Точки вида "x,y", начиная с аргумента first
+bool parsePoints(const QList<QByteArray> &args, int first, QVector<QPoint> *points)
+{
+    for (int i = first; i < args.size(); ++i) {
+        const QList<QByteArray> xy = args[i].split(',');
+        bool okX = false;
+        bool okY = false;
+        if (xy.size() != 2)
+            return false;
+        const QPoint point(xy[0].toInt(&okX), xy[1].toInt(&okY));
+        if (!okX || !okY || qAbs(point.x()) > MaxCoordinate || qAbs(point.y()) > MaxCoordinate)
+            return false;
+        points->append(point);
+    }
+    return !points->isEmpty();
+}
+
+// Остаток строки после count слов без изменения пробелов внутри: так
+// передаётся путь к файлу, в котором могут быть пробелы
+QByteArray tail(const QByteArray &line, int count)
+{
+    auto isSpace = [](char c) { return c == ' ' || c == '\t'; };
+    int pos = 0;
+    for (int i = 0; i < count; ++i) {
+        while (pos < line.size() && isSpace(line[pos]))
+            ++pos;
+        while (pos < line.size() && !isSpace(line[pos]))
+            ++pos;
+    }
+    return line.mid(pos).trimmed();
+}
+
+QByteArray number(qreal value)
+{
+    return QByteArray::number(value, 'f', 2);
+}
+
+} // namespace
+
+RenderService::RenderService(QObject *parent)
+    : QObject(parent)
+    , m_server(new QLocalServer(this))
+    , m_patternCache(std::make_shared<HatchPatternCache>())
+{
+    m_clock.start();
+    connect(m_server, &QLocalServer::newConnection, this, &RenderService::acceptConnections);
+
+    HatchPatternCache *cache = m_patternCache.get();
+    m_patternCacheSource = MemoryAccountant::instance().addSource(MemoryAccountant::PatternCache, [cache]() {
+        return cache->stats().bytes;
+    }, [cache]() {
+        const qint64 freed = cache->stats().bytes;
+        cache->clear();
+        return freed;
+    });
+}
+
+RenderService::~RenderService()
+{
+    MemoryAccountant::instance().removeSource(m_patternCacheSource);
+}
+
+bool RenderService::listen(const QString &name)
+{
+    // Сокет работающего экземпляра не трогается; удаляется только сокет,
+    // оставшийся от аварийно завершённого процесса, — на нём никто не отвечает
+    QLocalSocket probe;
+    probe.connectToServer(name);
+    if (probe.waitForConnected(500)) {
+        probe.disconnectFromServer();
+        m_listenError = QStringLiteral("%1 is served by another instance").arg(name);
+        return false;
+    }
+    QLocalServer::removeServer(name);
+
+    // Команды читают и пишут файлы с правами процесса, поэтому сокет
+    // доступен только его владельцу
+    m_listenError.clear();
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    return m_server->listen(name);
+}
+
+QString RenderService::errorString() const
+{
+    return m_listenError.isEmpty() ? m_server->errorString() : m_listenError;
+}
+
+void RenderService::acceptConnections()
+{
+    while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::readyRead, this, &RenderService::readRequests);
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+    }
+}
+
+void RenderService::readRequests()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+    if (!socket)
+        return;
+
+    // Все строки пакета считаются пришедшими одновременно
+    const qint64 received = m_clock.nsecsElapsed();
+    QByteArray responses;
+    while (socket->canReadLine()) {
+        const QByteArray line = socket->readLine().trimmed();
+        if (line.isEmpty())
+            continue;
+
+        const qint64 started = m_clock.nsecsElapsed();
+        bool ok = false;
+        const QByteArray payload = execute(line, &ok);
+        const qint64 finished = m_clock.nsecsElapsed();
+
+        ++m_requests;
+        m_failures += !ok;
+        m_totalExecNsecs += finished - started;
+
+        responses += ok ? "ok " : "error ";
+        responses += QByteArray::number((started - received) / 1000) + ' '
+                     + QByteArray::number((finished - started) / 1000);
+        if (!payload.isEmpty())
+            responses += ' ' + payload;
+        responses += '\n';
+    }
+
+    // Ответы пакета уходят одной записью
+    if (!responses.isEmpty())
+        socket->write(responses);
+}
+
+PaintView *RenderService::document(const QByteArray &name, QString *error)
+{
+    const auto it = m_documents.constFind(name);
+    if (it == m_documents.constEnd()) {
+        *error = QStringLiteral("unknown document %1").arg(QString::fromUtf8(name));
+        return nullptr;
+    }
+    return it->get();
+}
+
+QByteArray RenderService::execute(const QByteArray &line, bool *ok)
+{
+    const QList<QByteArray> args = line.simplified().split(' ');
+    const QByteArray command = args.value(0);
+    QString error;
+    QByteArray result;
+
+    if (command == "open" && args.size() >= 3) {
+        const QString fileName = QString::fromUtf8(tail(line, 2));
+        auto view = std::make_shared<PaintView>();
+        // Холст по размеру скана, а не виджета
+        view->resize(1, 1);
+        view->setPatternCache(m_patternCache);
+        if (view->openImage(fileName)) {
+            m_documents.insert(args[1], view);
+            result = QByteArray::number(view->layers().size().width()) + 'x'
+                     + QByteArray::number(view->layers().size().height());
+        } else {
+            error = QStringLiteral("cannot open %1").arg(fileName);
+        }
+    } else if (command == "hatch" && args.size() >= 4) {
+        HatchingTool::HatchType type;
+        QVector<QPoint> seeds;
+        if (!parseHatchType(args[2], &type)) {
+            error = QStringLiteral("unknown material %1").arg(QString::fromUtf8(args[2]));
+        } else if (!parsePoints(args, 3, &seeds)) {
+            error = QStringLiteral("bad point list");
+        } else if (PaintView *view = document(args[1], &error)) {
+            view->setHatchType(type);
+            const int regions = view->hatchSeeds(seeds);
+            const HatchingTool::Measurement &m = view->lastMeasurement();
+            result = "regions=" + QByteArray::number(regions);
+            if (regions > 0) {
+                result += " area=" + QByteArray::number(m.area)
+                          + " perimeter=" + QByteArray::number(m.perimeter)
+                          + " centroid=" + number(m.centroid.x()) + ',' + number(m.centroid.y());
+            }
+        }
+    } else if (command == "stroke" && args.size() >= 4) {
+        bool widthOk = false;
+        const int width = args[2].toInt(&widthOk);
+        QVector<QPoint> points;
+        if (!widthOk || width < MinPenWidth || width > MaxPenWidth) {
+            error = QStringLiteral("bad pen width %1, expected %2-%3")
+                        .arg(QString::fromUtf8(args[2])).arg(MinPenWidth).arg(MaxPenWidth);
+        } else if (!parsePoints(args, 3, &points)) {
+            error = QStringLiteral("bad point list");
+        } else if (PaintView *view = document(args[1], &error)) {
+            view->setPenWidth(width);
+            view->drawStroke(points);
+        }
+    } else if (command == "export" && args.size() >= 3) {
+        const QString fileName = QString::fromUtf8(tail(line, 2));
+        if (PaintView *view = document(args[1], &error)) {
+            if (!view->saveImage(fileName, nullptr))
+                error = QStringLiteral("cannot write %1").arg(fileName);
+        }
+    } else if (command == "close" && args.size() == 2) {
+        if (!m_documents.remove(args[1]))
+            error = QStringLiteral("unknown document %1").arg(QString::fromUtf8(args[1]));
+    } else if (command == "stats" && args.size() == 1) {
+        const HatchPatternCache::Stats cache = m_patternCache->stats();
+        result = "documents=" + QByteArray::number(m_documents.size())
+                 + " requests=" + QByteArray::number(m_requests)
+                 + " failures=" + QByteArray::number(m_failures)
+                 + " mean_exec_us=" + QByteArray::number(m_requests ? m_totalExecNsecs / m_requests / 1000 : 0)
+                 + " pattern_hits=" + QByteArray::number(cache.hits)
+                 + " pattern_misses=" + QByteArray::number(cache.misses)
+                 + " memory_bytes=" + QByteArray::number(MemoryAccountant::instance().total());
+    } else {
+        error = QStringLiteral("bad request: %1").arg(QString::fromUtf8(command));
+    }
+
+    if (ok)
+        *ok = error.isEmpty();
+    return error.isEmpty() ? result : error.toUtf8();
+}
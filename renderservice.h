@@ -0,0 +1,74 @@
+#ifndef RENDERSERVICE_H
+#define RENDERSERVICE_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <memory>
+
+class HatchPatternCache;
+class PaintView;
+class QLocalServer;
+class QLocalSocket;
+
+// Фоновый режим для автоматизации: документы и кэши рисунков остаются в
+// памяти между запросами, команды приходят построчно через локальный сокет
+// (на Unix — сокет домена Unix). Клиент может отправить несколько строк, не
+// дожидаясь ответов: они выполняются по порядку, на каждую приходит ровно
+// одна строка ответа.
+//
+//   open <док> <файл>                       открыть скан в документ
+//   hatch <док> <материал> <x>,<y> ...      заштриховать области под точками
+//   stroke <док> <толщина> <x>,<y> ...      провести линию карандашом
+//   export <док> <файл>                     сохранить сведённое изображение
+//   close <док>
+//   stats
+//
+// Путь к файлу — остаток строки после имени документа, пробелы внутри
+// пути сохраняются. Толщина пера — от 1 до 50, как в диалоге; координаты
+// по модулю не больше 65536. Остальное отклоняется строкой ошибки.
+//
+// Ответ: "ok <ожидание мкс> <выполнение мкс> [данные]" или
+// "error <ожидание мкс> <выполнение мкс> <сообщение>". Ожидание — время от
+// получения строки до начала выполнения, то есть очередь за предыдущими
+// командами того же пакета.
+class RenderService : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RenderService(QObject *parent = nullptr);
+    ~RenderService();
+
+    // Не запускается, если на имени уже отвечает другой экземпляр. Сокет
+    // доступен только пользователю, запустившему процесс
+    bool listen(const QString &name);
+    QString errorString() const;
+
+    // Выполняет одну команду без сокета; возвращает строку ответа без
+    // времени выполнения
+    QByteArray execute(const QByteArray &line, bool *ok = nullptr);
+
+private slots:
+    void acceptConnections();
+    void readRequests();
+
+private:
+    PaintView *document(const QByteArray &name, QString *error);
+
+    QLocalServer *m_server;
+    QString m_listenError;
+    QElapsedTimer m_clock;
+    QHash<QByteArray, std::shared_ptr<PaintView>> m_documents;
+    // Кэш плиток штриховки общий для всех документов, как у вкладок MainWindow
+    std::shared_ptr<HatchPatternCache> m_patternCache;
+    int m_patternCacheSource = 0;
+
+    qint64 m_requests = 0;
+    qint64 m_failures = 0;
+    qint64 m_totalExecNsecs = 0;
+};
+
+#endif // RENDERSERVICE_H
@@ -0,0 +1,244 @@
+#include "scanprocessor.h"
+#include "parallel.h"
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QPainter>
+#include <QThread>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Делит [0, count) на полосы и обрабатывает их на пуле
+void forBands(int count, QThreadPool *pool, const std::function<void(int, int)> &body)
+{
+    const int bands = qBound(1, QThread::idealThreadCount() * 4, qMax(1, count / 16));
+    parallelFor(bands, [&](int band) {
+        const int from = int(qint64(count) * band / bands);
+        const int to = int(qint64(count) * (band + 1) / bands);
+        if (from < to)
+            body(from, to);
+    }, pool);
+}
+
+// Интегральное изображение (width + 1) × (height + 1). Суммы считаются по
+// модулю 2^32: разность для окна всё равно точна, пока окно меньше 2^32
+void buildIntegral(const std::vector<uchar> &values, int width, int height,
+                   std::vector<quint32> &integral, QThreadPool *pool)
+{
+    const int stride = width + 1;
+    integral.assign(size_t(stride) * size_t(height + 1), 0);
+
+    // Префиксные суммы строк независимы
+    forBands(height, pool, [&](int from, int to) {
+        for (int y = from; y < to; ++y) {
+            const uchar *src = values.data() + size_t(y) * width;
+            quint32 *dst = integral.data() + size_t(y + 1) * stride + 1;
+            quint32 sum = 0;
+            for (int x = 0; x < width; ++x) {
+                sum += src[x];
+                dst[x] = sum;
+            }
+        }
+    });
+
+    // Накопление по столбцам: полосы столбцов независимы, внутри строки — SSE2
+    const int groups = (stride + 3) / 4;
+    forBands(groups, pool, [&](int from, int to) {
+        const int x0 = from * 4;
+        const int x1 = qMin(stride, to * 4);
+        for (int y = 1; y <= height; ++y) {
+            const quint32 *above = integral.data() + size_t(y - 1) * stride;
+            quint32 *row = integral.data() + size_t(y) * stride;
+            int x = x0;
+#ifdef __SSE2__
+            for (; x + 4 <= x1; x += 4) {
+                const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(above + x));
+                const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(row + x), _mm_add_epi32(a, r));
+            }
+#endif
+            for (; x < x1; ++x)
+                row[x] += above[x];
+        }
+    });
+}
+
+inline quint32 windowSum(const std::vector<quint32> &integral, int stride,
+                         int x0, int y0, int x1, int y1)
+{
+    const quint32 *top = integral.data() + size_t(y0) * stride;
+    const quint32 *bottom = integral.data() + size_t(y1 + 1) * stride;
+    return bottom[x1 + 1] - top[x1 + 1] - bottom[x0] + top[x0];
+}
+
+// Один подшаг утончения Чжана–Суэня; возвращает число удалённых пикселей
+int thinningStep(std::vector<uchar> &ink, std::vector<uchar> &marks, int width, int height,
+                 bool firstPass, QThreadPool *pool)
+{
+    QAtomicInt removed(0);
+    forBands(height, pool, [&](int from, int to) {
+        int local = 0;
+        for (int y = qMax(1, from); y < qMin(height - 1, to); ++y) {
+            const uchar *up = ink.data() + size_t(y - 1) * width;
+            const uchar *row = ink.data() + size_t(y) * width;
+            const uchar *down = ink.data() + size_t(y + 1) * width;
+            uchar *mark = marks.data() + size_t(y) * width;
+            for (int x = 1; x < width - 1; ++x) {
+                mark[x] = 0;
+                if (!row[x])
+                    continue;
+                // Соседи по часовой стрелке, начиная сверху
+                const int p[8] = {up[x], up[x + 1], row[x + 1], down[x + 1],
+                                  down[x], down[x - 1], row[x - 1], up[x - 1]};
+                int neighbours = 0;
+                int transitions = 0;
+                for (int i = 0; i < 8; ++i) {
+                    neighbours += p[i];
+                    transitions += (!p[i] && p[(i + 1) % 8]) ? 1 : 0;
+                }
+                if (neighbours < 2 || neighbours > 6 || transitions != 1)
+                    continue;
+                const bool remove = firstPass
+                                        ? !(p[0] && p[2] && p[4]) && !(p[2] && p[4] && p[6])
+                                        : !(p[0] && p[2] && p[6]) && !(p[0] && p[4] && p[6]);
+                if (remove) {
+                    mark[x] = 1;
+                    ++local;
+                }
+            }
+        }
+        removed.fetchAndAddRelaxed(local);
+    });
+
+    forBands(height, pool, [&](int from, int to) {
+        for (int y = qMax(1, from); y < qMin(height - 1, to); ++y) {
+            uchar *row = ink.data() + size_t(y) * width;
+            const uchar *mark = marks.data() + size_t(y) * width;
+            for (int x = 1; x < width - 1; ++x) {
+                if (mark[x])
+                    row[x] = 0;
+            }
+        }
+    });
+    return removed.loadRelaxed();
+}
+
+} // namespace
+
+QImage ScanProcessor::process(const QImage &scan, Stats *stats, QThreadPool *pool) const
+{
+    if (!pool)
+        pool = QThreadPool::globalInstance();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Прозрачные участки скана считаются бумагой
+    QImage source(scan.size(), QImage::Format_RGB32);
+    source.fill(Qt::white);
+    {
+        QPainter painter(&source);
+        painter.drawImage(QPoint(0, 0), scan);
+    }
+
+    const int width = source.width();
+    const int height = source.height();
+    if (width == 0 || height == 0)
+        return QImage();
+
+    std::vector<uchar> gray(size_t(width) * height);
+    forBands(height, pool, [&](int from, int to) {
+        for (int y = from; y < to; ++y) {
+            const QRgb *src = reinterpret_cast<const QRgb *>(source.constScanLine(y));
+            uchar *dst = gray.data() + size_t(y) * width;
+            for (int x = 0; x < width; ++x)
+                dst[x] = uchar(qGray(src[x]));
+        }
+    });
+
+    // Адаптивный порог Брэдли: темнее среднего по окну на thresholdPercent %
+    std::vector<quint32> integral;
+    buildIntegral(gray, width, height, integral, pool);
+
+    const int stride = width + 1;
+    const int radius = qMax(1, m_options.windowSize / 2);
+    const int keepPercent = 100 - qBound(0, m_options.thresholdPercent, 100);
+    std::vector<uchar> ink(size_t(width) * height);
+    forBands(height, pool, [&](int from, int to) {
+        for (int y = from; y < to; ++y) {
+            const int y0 = qMax(0, y - radius);
+            const int y1 = qMin(height - 1, y + radius);
+            const uchar *src = gray.data() + size_t(y) * width;
+            uchar *dst = ink.data() + size_t(y) * width;
+            for (int x = 0; x < width; ++x) {
+                const int x0 = qMax(0, x - radius);
+                const int x1 = qMin(width - 1, x + radius);
+                const quint64 count = quint64(x1 - x0 + 1) * quint64(y1 - y0 + 1);
+                const quint64 sum = windowSum(integral, stride, x0, y0, x1, y1);
+                dst[x] = quint64(src[x]) * count * 100 < sum * keepPercent ? 1 : 0;
+            }
+        }
+    });
+
+    // Мусор: мало пикселей линии в окне 5×5. Прокол: фон, окружённый линией
+    buildIntegral(ink, width, height, integral, pool);
+    std::vector<uchar> clean(size_t(width) * height);
+    forBands(height, pool, [&](int from, int to) {
+        for (int y = from; y < to; ++y) {
+            const uchar *src = ink.data() + size_t(y) * width;
+            uchar *dst = clean.data() + size_t(y) * width;
+            for (int x = 0; x < width; ++x) {
+                if (src[x]) {
+                    const quint32 around = windowSum(integral, stride,
+                                                     qMax(0, x - 2), qMax(0, y - 2),
+                                                     qMin(width - 1, x + 2), qMin(height - 1, y + 2));
+                    dst[x] = around >= quint32(m_options.minSpeckleNeighbourhood) ? 1 : 0;
+                } else {
+                    const quint32 around = windowSum(integral, stride,
+                                                     qMax(0, x - 1), qMax(0, y - 1),
+                                                     qMin(width - 1, x + 1), qMin(height - 1, y + 1));
+                    dst[x] = around >= 7 ? 1 : 0;
+                }
+            }
+        }
+    });
+
+    if (m_options.thinning) {
+        std::vector<uchar> marks(size_t(width) * height, 0);
+        while (thinningStep(clean, marks, width, height, true, pool)
+               + thinningStep(clean, marks, width, height, false, pool) > 0) {
+        }
+    }
+
+    QImage result(width, height, QImage::Format_ARGB32_Premultiplied);
+    // Неконстантный scanLine() отсоединяет изображение и в потоках не
+    // вызывается: указатель на пиксели берётся один раз заранее
+    uchar *bits = result.bits();
+    const qsizetype bytesPerLine = result.bytesPerLine();
+    QAtomicInteger<qint64> inkPixels(0);
+    forBands(height, pool, [&](int from, int to) {
+        qint64 local = 0;
+        for (int y = from; y < to; ++y) {
+            const uchar *src = clean.data() + size_t(y) * width;
+            QRgb *dst = reinterpret_cast<QRgb *>(bits + y * bytesPerLine);
+            for (int x = 0; x < width; ++x) {
+                dst[x] = src[x] ? qRgba(0, 0, 0, 255) : qRgba(0, 0, 0, 0);
+                local += src[x];
+            }
+        }
+        inkPixels.fetchAndAddRelaxed(local);
+    });
+
+    if (stats) {
+        stats->nsecs = timer.nsecsElapsed();
+        stats->megapixelsPerSecond = stats->nsecs > 0
+                                         ? double(width) * height / 1e6 / (stats->nsecs / 1e9)
+                                         : 0;
+        stats->inkPixels = inkPixels.loadRelaxed();
+    }
+    return result;
+}
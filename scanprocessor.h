@@ -0,0 +1,43 @@
+#ifndef SCANPROCESSOR_H
+#define SCANPROCESSOR_H
+
+#include <QImage>
+
+class QThreadPool;
+
+// Очистка отсканированного чертежа: адаптивная бинаризация по интегральному
+// изображению, удаление мелкого мусора и закрытие проколов в линиях,
+// по желанию — утончение линий до толщины в один пиксель. Все этапы
+// выполняются параллельно по полосам строк или столбцов.
+class ScanProcessor
+{
+public:
+    struct Options
+    {
+        // Сторона окна усреднения, пикселей
+        int windowSize = 31;
+        // Пиксель — линия, если он темнее среднего по окну на столько процентов
+        int thresholdPercent = 15;
+        // Меньше стольких пикселей линии в окне 5×5 — мусор
+        int minSpeckleNeighbourhood = 4;
+        bool thinning = false;
+    };
+
+    struct Stats
+    {
+        qint64 nsecs = 0;
+        double megapixelsPerSecond = 0;
+        qint64 inkPixels = 0;
+    };
+
+    ScanProcessor() = default;
+    explicit ScanProcessor(const Options &options) : m_options(options) {}
+
+    // Возвращает слой контуров: чёрные линии на прозрачном фоне
+    QImage process(const QImage &scan, Stats *stats = nullptr, QThreadPool *pool = nullptr) const;
+
+private:
+    Options m_options;
+};
+
+#endif // SCANPROCESSOR_H
@@ -0,0 +1,103 @@
+#include "startupprofile.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <QTimer>
+#include <QVector>
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct Stage
+{
+    const char *name;
+    qint64 nsecs;
+};
+
+QElapsedTimer s_timer;
+QVector<Stage> s_stages;
+bool s_enabled = false;
+bool s_painted = false;
+
+// Время от запуска процесса до входа в main: загрузка библиотек и
+// статическая инициализация. Известно только там, где его сообщает система
+double processStartOffsetMs()
+{
+#ifdef Q_OS_LINUX
+    QFile statFile("/proc/self/stat");
+    QFile uptimeFile("/proc/uptime");
+    if (!statFile.open(QIODevice::ReadOnly) || !uptimeFile.open(QIODevice::ReadOnly))
+        return -1;
+
+    // Поле 22 (starttime) считается после имени процесса в скобках
+    const QByteArray stat = statFile.readAll();
+    const QList<QByteArray> fields = stat.mid(stat.lastIndexOf(')') + 2).split(' ');
+    if (fields.size() < 20)
+        return -1;
+    const double startTicks = fields[19].toDouble();
+    const double uptime = uptimeFile.readAll().split(' ').value(0).toDouble();
+    const double ticksPerSecond = double(sysconf(_SC_CLK_TCK));
+    return (uptime - startTicks / ticksPerSecond) * 1000.0 - s_timer.nsecsElapsed() / 1e6;
+#else
+    return -1;
+#endif
+}
+
+} // namespace
+
+namespace StartupProfile {
+
+void start()
+{
+    s_timer.start();
+}
+
+void setEnabled(bool enabled)
+{
+    s_enabled = enabled;
+}
+
+bool isEnabled()
+{
+    return s_enabled;
+}
+
+void mark(const char *stage)
+{
+    // Этапы до разбора аргументов записываются всегда, отметок немного
+    if (!s_painted)
+        s_stages.append({stage, s_timer.nsecsElapsed()});
+}
+
+void firstPaint()
+{
+    if (s_painted)
+        return;
+    mark("first paint");
+    s_painted = true;
+    if (!s_enabled)
+        return;
+
+    QTextStream out(stdout);
+    const double beforeMain = processStartOffsetMs();
+    if (beforeMain >= 0)
+        out << QString("%1 %2 ms\n").arg("process start -> main", -28).arg(beforeMain, 9, 'f', 1);
+
+    qint64 previous = 0;
+    for (const Stage &stage : std::as_const(s_stages)) {
+        out << QString("%1 %2 ms (+%3 ms)\n")
+                   .arg(QString("main -> ") + stage.name, -28)
+                   .arg(stage.nsecs / 1e6, 9, 'f', 1)
+                   .arg((stage.nsecs - previous) / 1e6, 0, 'f', 1);
+        previous = stage.nsecs;
+    }
+    out.flush();
+
+    QTimer::singleShot(0, qApp, &QCoreApplication::quit);
+}
+
+} // namespace StartupProfile
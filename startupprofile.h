@@ -0,0 +1,20 @@
+#ifndef STARTUPPROFILE_H
+#define STARTUPPROFILE_H
+
+// Замер холодного запуска (--startup-profile): время от старта процесса
+// до первой отрисовки холста с промежуточными этапами
+namespace StartupProfile {
+
+// Вызывается первой строкой main
+void start();
+void setEnabled(bool enabled);
+bool isEnabled();
+
+void mark(const char *stage);
+// Вызывается из отрисовки холста; в первый раз при включённом замере
+// печатает отчёт и завершает приложение
+void firstPaint();
+
+} // namespace StartupProfile
+
+#endif // STARTUPPROFILE_H
@@ -0,0 +1,115 @@
+#include "strokeprocessor.h"
+#include <QtMath>
+#include <cmath>
+
+namespace {
+
+qreal smoothingFactor(qreal cutoff, qreal dt)
+{
+    const qreal tau = 1.0 / (2 * M_PI * cutoff);
+    return 1.0 / (1.0 + tau / dt);
+}
+
+qreal length(const QPointF &v)
+{
+    return std::sqrt(QPointF::dotProduct(v, v));
+}
+
+} // namespace
+
+QPointF StrokeProcessor::begin(const QPointF &point, qint64 timestamp)
+{
+    m_points.clear();
+    m_inputCount = 1;
+
+    m_filtered = point;
+    m_raw = point;
+    m_velocity = QPointF();
+    m_lastTimestamp = timestamp;
+
+    m_anchor = point;
+    m_pending = point;
+    m_pendingCount = 0;
+    m_hasDirection = false;
+
+    m_points.append(point);
+    return point;
+}
+
+bool StrokeProcessor::addPoint(const QPointF &point, qint64 timestamp, QPointF &vertex)
+{
+    ++m_inputCount;
+    m_raw = point;
+    const QPointF p = filter(point, timestamp);
+
+    bool emitted = false;
+    if (m_hasDirection) {
+        const QPointF offset = p - m_anchor;
+        const qreal along = QPointF::dotProduct(offset, m_direction);
+        const qreal across = std::abs(offset.x() * m_direction.y() - offset.y() * m_direction.x());
+        const qreal pendingAlong = QPointF::dotProduct(m_pending - m_anchor, m_direction);
+
+        // Точка вышла из полосы, штрих развернулся или хвост стал слишком длинным
+        if (across > m_tolerance || along < pendingAlong
+            || pendingAlong > m_maxRunLength || m_pendingCount >= m_maxPendingPoints) {
+            vertex = m_pending;
+            emitVertex(m_pending);
+            emitted = true;
+        }
+    }
+
+    if (!m_hasDirection) {
+        const QPointF offset = p - m_anchor;
+        const qreal distance = length(offset);
+        if (distance > m_tolerance) {
+            m_direction = offset / distance;
+            m_hasDirection = true;
+        }
+    }
+
+    m_pending = p;
+    ++m_pendingCount;
+    return emitted;
+}
+
+bool StrokeProcessor::finish(QPointF &vertex)
+{
+    // Штрих заканчивается там, где кнопку отпустили, без запаздывания фильтра
+    if (m_raw == m_points.last())
+        return false;
+
+    vertex = m_raw;
+    m_points.append(m_raw);
+    return true;
+}
+
+qreal StrokeProcessor::reductionRatio() const
+{
+    return m_points.isEmpty() ? 1.0 : qreal(m_inputCount) / m_points.size();
+}
+
+QPointF StrokeProcessor::filter(const QPointF &point, qint64 timestamp)
+{
+    if (!m_smoothing)
+        return point;
+
+    const qreal dt = qMax<qint64>(1, timestamp - m_lastTimestamp) / 1000.0;
+    m_lastTimestamp = timestamp;
+
+    const QPointF velocity = (point - m_filtered) / dt;
+    const qreal dAlpha = smoothingFactor(m_derivativeCutoff, dt);
+    m_velocity += dAlpha * (velocity - m_velocity);
+
+    const qreal cutoff = m_minCutoff + m_beta * length(m_velocity);
+    const qreal alpha = smoothingFactor(cutoff, dt);
+    m_filtered += alpha * (point - m_filtered);
+    return m_filtered;
+}
+
+void StrokeProcessor::emitVertex(const QPointF &vertex)
+{
+    m_points.append(vertex);
+    m_anchor = vertex;
+    m_pendingCount = 0;
+    m_hasDirection = false;
+}
@@ -0,0 +1,60 @@
+#ifndef STROKEPROCESSOR_H
+#define STROKEPROCESSOR_H
+
+#include <QPointF>
+#include <QVector>
+
+// Потоковая обработка точек штриха: сглаживание фильтром One Euro и
+// упрощение полосой Реуманна–Виткама. Каждая входная точка обрабатывается
+// за постоянное время, вершины выдаются по мере появления.
+class StrokeProcessor
+{
+public:
+    StrokeProcessor() = default;
+
+    void setSmoothing(bool enabled) { m_smoothing = enabled; }
+    void setTolerance(qreal tolerance) { m_tolerance = tolerance; }
+
+    // Начало штриха; возвращает первую вершину
+    QPointF begin(const QPointF &point, qint64 timestamp);
+    // true, если появилась новая вершина (её нужно дорисовать от предыдущей)
+    bool addPoint(const QPointF &point, qint64 timestamp, QPointF &vertex);
+    // Завершение штриха: последняя вершина, если она ещё не выдана
+    bool finish(QPointF &vertex);
+
+    const QVector<QPointF> &points() const { return m_points; }
+    int inputCount() const { return m_inputCount; }
+    qreal reductionRatio() const;
+
+private:
+    QPointF filter(const QPointF &point, qint64 timestamp);
+    void emitVertex(const QPointF &vertex);
+
+    // Параметры фильтра One Euro (частоты в Гц)
+    qreal m_minCutoff = 3.0;
+    qreal m_beta = 0.05;
+    qreal m_derivativeCutoff = 1.0;
+
+    bool m_smoothing = true;
+    qreal m_tolerance = 0.5;
+    qreal m_maxRunLength = 24;
+    int m_maxPendingPoints = 4;
+
+    // Состояние фильтра
+    QPointF m_filtered;
+    QPointF m_velocity;
+    qint64 m_lastTimestamp = 0;
+
+    // Состояние упрощения
+    QPointF m_anchor;
+    QPointF m_direction;
+    bool m_hasDirection = false;
+    QPointF m_pending;
+    int m_pendingCount = 0;
+    QPointF m_raw;
+
+    QVector<QPointF> m_points;
+    int m_inputCount = 0;
+};
+
+#endif // STROKEPROCESSOR_H
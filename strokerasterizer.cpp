@@ -0,0 +1,274 @@
+#include "strokerasterizer.h"
+#include <QPainter>
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+struct Interval
+{
+    qreal lo;
+    qreal hi;
+
+    bool isEmpty() const { return lo > hi; }
+};
+
+const Interval EmptyInterval = {1, 0};
+
+Interval unite(const Interval &a, const Interval &b)
+{
+    if (a.isEmpty()) return b;
+    if (b.isEmpty()) return a;
+    return {qMin(a.lo, b.lo), qMax(a.hi, b.hi)};
+}
+
+Interval intersect(const Interval &a, const Interval &b)
+{
+    return {qMax(a.lo, b.lo), qMin(a.hi, b.hi)};
+}
+
+// Решение lo <= k * x + b <= hi относительно x
+Interval solveLinear(qreal k, qreal b, qreal lo, qreal hi)
+{
+    if (std::abs(k) < 1e-12) {
+        if (b >= lo && b <= hi)
+            return {-1e9, 1e9};
+        return EmptyInterval;
+    }
+    qreal x0 = (lo - b) / k;
+    qreal x1 = (hi - b) / k;
+    if (x0 > x1)
+        std::swap(x0, x1);
+    return {x0, x1};
+}
+
+struct Segment
+{
+    Segment(const QPointF &from, const QPointF &to)
+        : a(from)
+    {
+        const QPointF d = to - from;
+        length = std::sqrt(d.x() * d.x() + d.y() * d.y());
+        if (length > 0) {
+            ux = d.x() / length;
+            uy = d.y() / length;
+        }
+    }
+
+    qreal distanceTo(qreal px, qreal py) const
+    {
+        const qreal dx = px - a.x();
+        const qreal dy = py - a.y();
+        const qreal t = qBound(qreal(0), dx * ux + dy * uy, length);
+        const qreal ex = dx - ux * t;
+        const qreal ey = dy - uy * t;
+        return std::sqrt(ex * ex + ey * ey);
+    }
+
+    // Пересечение горизонтали y = py с капсулой радиуса radius вокруг отрезка.
+    // Капсула выпукла, поэтому пересечение — один интервал: объединение
+    // пересечений с двумя кругами на концах и с прямоугольником между ними.
+    Interval span(qreal radius, qreal py) const
+    {
+        const qreal dy = py - a.y();
+        Interval result = EmptyInterval;
+
+        const qreal h0 = radius * radius - dy * dy;
+        if (h0 >= 0) {
+            const qreal w = std::sqrt(h0);
+            result = {a.x() - w, a.x() + w};
+        }
+
+        if (length > 0) {
+            const qreal bx = a.x() + ux * length;
+            const qreal dyb = py - (a.y() + uy * length);
+            const qreal h1 = radius * radius - dyb * dyb;
+            if (h1 >= 0) {
+                const qreal w = std::sqrt(h1);
+                result = unite(result, {bx - w, bx + w});
+            }
+
+            // Нормаль (-uy, ux): |n·(p - a)| <= radius, 0 <= u·(p - a) <= length
+            const Interval band = solveLinear(-uy, ux * dy + uy * a.x(), -radius, radius);
+            const Interval slab = solveLinear(ux, uy * dy - ux * a.x(), 0, length);
+            result = unite(result, intersect(band, slab));
+        }
+        return result;
+    }
+
+    QPointF a;
+    qreal ux = 1;
+    qreal uy = 0;
+    qreal length = 0;
+};
+
+// Умножение всех каналов пикселя на alpha / 255
+inline QRgb byteMul(QRgb x, uint alpha)
+{
+    uint t = (x & 0xff00ff) * alpha;
+    t = (t + ((t >> 8) & 0xff00ff) + 0x800080) >> 8;
+    t &= 0xff00ff;
+
+    x = ((x >> 8) & 0xff00ff) * alpha;
+    x = x + ((x >> 8) & 0xff00ff) + 0x800080;
+    x &= 0xff00ff00;
+    return x | t;
+}
+
+inline QRgb sourceOver(QRgb dst, QRgb src)
+{
+    return src + byteMul(dst, 255 - qAlpha(src));
+}
+
+inline int pixelFloor(qreal v) { return int(std::floor(qBound(qreal(-1e9), v, qreal(1e9)))); }
+inline int pixelCeil(qreal v) { return int(std::ceil(qBound(qreal(-1e9), v, qreal(1e9)))); }
+
+} // namespace
+
+StrokeRasterizer::StrokeRasterizer(QImage &image)
+    : m_image(image)
+    , m_premultipliedTarget(image.format() != QImage::Format_ARGB32)
+{
+}
+
+bool StrokeRasterizer::canRasterize(const QPainter &painter)
+{
+    QPaintDevice *device = painter.device();
+    if (!painter.isActive() || !device || device->devType() != QInternal::Image)
+        return false;
+
+    const QImage::Format format = static_cast<QImage *>(device)->format();
+    if (format != QImage::Format_ARGB32 && format != QImage::Format_ARGB32_Premultiplied
+        && format != QImage::Format_RGB32)
+        return false;
+
+    return painter.transform().isIdentity()
+           && !painter.hasClipping()
+           && painter.opacity() == 1.0
+           && painter.compositionMode() == QPainter::CompositionMode_SourceOver
+           && painter.testRenderHint(QPainter::Antialiasing);
+}
+
+void StrokeRasterizer::setColor(const QColor &color)
+{
+    m_color = qPremultiply(color.rgba());
+}
+
+void StrokeRasterizer::setWidth(qreal width)
+{
+    m_radius = qMax(qreal(1), width) / 2;
+}
+
+QRect StrokeRasterizer::drawSegment(const QPointF &from, const QPointF &to)
+{
+    const Segment segment(from, to);
+    const qreal outer = m_radius + 0.5;
+    const qreal inner = m_radius - 0.5;
+    const int width = m_image.width();
+
+    const int top = qMax(0, pixelFloor(qMin(from.y(), to.y()) - outer));
+    const int bottom = qMin(m_image.height() - 1, pixelCeil(qMax(from.y(), to.y()) + outer));
+
+    QRect touched;
+    for (int y = top; y <= bottom; ++y) {
+        const qreal py = y + 0.5;
+        const Interval outerSpan = segment.span(outer, py);
+        if (outerSpan.isEmpty())
+            continue;
+
+        // Пиксель x затронут, если его центр x + 0.5 попадает в интервал
+        const int x0 = qMax(0, pixelCeil(outerSpan.lo - 0.5));
+        const int x1 = qMin(width - 1, pixelFloor(outerSpan.hi - 0.5));
+        if (x0 > x1)
+            continue;
+
+        int solid0 = x1 + 1;
+        int solid1 = x1;
+        if (inner > 0) {
+            const Interval innerSpan = segment.span(inner, py);
+            if (!innerSpan.isEmpty()) {
+                solid0 = qMax(x0, pixelCeil(innerSpan.lo - 0.5));
+                solid1 = qMin(x1, pixelFloor(innerSpan.hi - 0.5));
+                if (solid0 > solid1) {
+                    solid0 = x1 + 1;
+                    solid1 = x1;
+                }
+            }
+        }
+
+        QRgb *line = reinterpret_cast<QRgb *>(m_image.scanLine(y));
+        for (int x = x0; x < solid0; ++x) {
+            const qreal coverage = outer - segment.distanceTo(x + 0.5, py);
+            blendPixel(line + x, qRound(qBound(qreal(0), coverage, qreal(1)) * 255));
+        }
+        fillSpan(line, solid0, solid1 + 1);
+        for (int x = solid1 + 1; x <= x1; ++x) {
+            const qreal coverage = outer - segment.distanceTo(x + 0.5, py);
+            blendPixel(line + x, qRound(qBound(qreal(0), coverage, qreal(1)) * 255));
+        }
+
+        touched |= QRect(x0, y, x1 - x0 + 1, 1);
+    }
+    return touched;
+}
+
+void StrokeRasterizer::fillSpan(QRgb *line, int from, int to)
+{
+    if (from >= to)
+        return;
+
+    if (qAlpha(m_color) == 255) {
+        std::fill(line + from, line + to, m_color);
+        return;
+    }
+
+    int x = from;
+#ifdef __SSE2__
+    const __m128i src = _mm_set1_epi32(int(m_color));
+    const __m128i inverseAlpha = _mm_set1_epi16(short(255 - qAlpha(m_color)));
+    const __m128i half = _mm_set1_epi16(0x80);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaMask = _mm_set1_epi32(int(0xff000000));
+
+    for (; x + 4 <= to; x += 4) {
+        __m128i *ptr = reinterpret_cast<__m128i *>(line + x);
+        const __m128i dst = _mm_loadu_si128(ptr);
+
+        // В формате без предумножения векторно смешиваются только непрозрачные пиксели
+        if (!m_premultipliedTarget) {
+            const __m128i alpha = _mm_and_si128(dst, alphaMask);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alphaMask)) != 0xffff) {
+                for (int i = 0; i < 4; ++i)
+                    blendPixel(line + x + i, 255);
+                continue;
+            }
+        }
+
+        __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(dst, zero), inverseAlpha);
+        __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(dst, zero), inverseAlpha);
+        lo = _mm_add_epi16(lo, half);
+        hi = _mm_add_epi16(hi, half);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        _mm_storeu_si128(ptr, _mm_adds_epu8(_mm_packus_epi16(lo, hi), src));
+    }
+#endif
+    for (; x < to; ++x)
+        blendPixel(line + x, 255);
+}
+
+void StrokeRasterizer::blendPixel(QRgb *pixel, int coverage) const
+{
+    if (coverage <= 0)
+        return;
+
+    const QRgb src = coverage >= 255 ? m_color : byteMul(m_color, uint(coverage));
+    if (m_premultipliedTarget || qAlpha(*pixel) == 255)
+        *pixel = sourceOver(*pixel, src);
+    else
+        *pixel = qUnpremultiply(sourceOver(qPremultiply(*pixel), src));
+}
@@ -0,0 +1,39 @@
+#ifndef STROKERASTERIZER_H
+#define STROKERASTERIZER_H
+
+#include <QColor>
+#include <QImage>
+#include <QPointF>
+#include <QRect>
+
+class QPainter;
+
+// Растеризатор толстых линий со скруглёнными концами сплошным цветом.
+// Покрытие считается по строкам: внутренняя часть строки заливается целиком,
+// сглаживание вычисляется только для пикселей на краю линии.
+class StrokeRasterizer
+{
+public:
+    explicit StrokeRasterizer(QImage &image);
+
+    // Можно ли рисовать напрямую в устройство художника вместо QPainter::drawLine
+    static bool canRasterize(const QPainter &painter);
+
+    void setColor(const QColor &color);
+    void setWidth(qreal width);
+
+    // Возвращают прямоугольник изменённых пикселей
+    QRect drawSegment(const QPointF &from, const QPointF &to);
+    QRect drawPoint(const QPointF &point) { return drawSegment(point, point); }
+
+private:
+    void fillSpan(QRgb *line, int from, int to);
+    void blendPixel(QRgb *pixel, int coverage) const;
+
+    QImage &m_image;
+    QRgb m_color = 0; // предумноженный цвет
+    qreal m_radius = 0.5;
+    bool m_premultipliedTarget = false;
+};
+
+#endif // STROKERASTERIZER_H
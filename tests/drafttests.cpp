@@ -0,0 +1,733 @@
+#include "benchmark.h"
+#include "fillmask.h"
+#include "fillregion.h"
+#include "hatchingtool.h"
+#include "paintview.h"
+#include "renderservice.h"
+
+#include <QApplication>
+#include <QDir>
+#include <QFile>
+#include <QKeyEvent>
+#include <QLocalSocket>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QSet>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QtTest>
+#include <cmath>
+
+// Регрессионные тесты: сценарии рисования сравниваются с эталонными
+// изображениями, замеры --benchmark — с сохранёнными значениями.
+// Эталоны лежат рядом с тестами, и отсутствующий эталон — ошибка: тест не
+// проходит молча без сравнения. DRAFT_UPDATE_GOLDEN=1 и
+// DRAFT_UPDATE_BASELINE=1 вместо сравнения перезаписывают эталоны.
+
+namespace {
+
+const QSize CanvasSize(500, 500);
+const int Cell = 100;
+// Замеры короче этого слишком шумные для сравнения
+const qint64 MinMeasuredNs = 1000000;
+
+int envInt(const char *name, int defaultValue)
+{
+    bool ok = false;
+    const int value = qEnvironmentVariableIntValue(name, &ok);
+    return ok ? value : defaultValue;
+}
+
+bool envFlag(const char *name)
+{
+    return envInt(name, 0) != 0;
+}
+
+// Лист с сеткой замкнутых ячеек Cell × Cell, линии толщиной 2 пикселя
+QImage gridFixture()
+{
+    QImage image(CanvasSize, QImage::Format_ARGB32);
+    image.fill(Qt::white);
+    QPainter painter(&image);
+    painter.setPen(QPen(Qt::black, 2));
+    for (int x = 0; x <= CanvasSize.width(); x += Cell)
+        painter.drawLine(x, 0, x, CanvasSize.height());
+    for (int y = 0; y <= CanvasSize.height(); y += Cell)
+        painter.drawLine(0, y, CanvasSize.width(), y);
+    return image;
+}
+
+// Сценарий действий пользователя: события отправляются прямо в холст,
+// время событий растёт равномерно, чтобы сглаживание было воспроизводимым
+class Script
+{
+public:
+    explicit Script(PaintView &view) : m_view(view) {}
+
+    void press(const QPoint &point, Qt::KeyboardModifiers modifiers = Qt::NoModifier)
+    {
+        mouse(QEvent::MouseButtonPress, point, Qt::LeftButton, Qt::LeftButton, modifiers);
+    }
+
+    void move(const QPoint &point)
+    {
+        mouse(QEvent::MouseMove, point, Qt::NoButton, Qt::LeftButton, Qt::NoModifier);
+    }
+
+    void release(const QPoint &point, Qt::KeyboardModifiers modifiers = Qt::NoModifier)
+    {
+        mouse(QEvent::MouseButtonRelease, point, Qt::LeftButton, Qt::NoButton, modifiers);
+    }
+
+    void click(const QPoint &point, Qt::KeyboardModifiers modifiers = Qt::NoModifier)
+    {
+        press(point, modifiers);
+        release(point, modifiers);
+    }
+
+    void stroke(const QVector<QPoint> &points)
+    {
+        press(points.first());
+        for (int i = 1; i < points.size(); ++i)
+            move(points[i]);
+        release(points.last());
+    }
+
+    void key(int key)
+    {
+        QKeyEvent event(QEvent::KeyPress, key, Qt::NoModifier);
+        QApplication::sendEvent(&m_view, &event);
+    }
+
+private:
+    void mouse(QEvent::Type type, const QPoint &point, Qt::MouseButton button,
+               Qt::MouseButtons buttons, Qt::KeyboardModifiers modifiers)
+    {
+        QMouseEvent event(type, QPointF(point), QPointF(m_view.mapToGlobal(point)),
+                          button, buttons, modifiers);
+        m_timestamp += 8;
+        event.setTimestamp(m_timestamp);
+        QApplication::sendEvent(&m_view, &event);
+    }
+
+    PaintView &m_view;
+    ulong m_timestamp = 1000;
+};
+
+struct Difference
+{
+    int pixels = 0;
+    int maxDelta = 0;
+    QImage mask;
+};
+
+Difference compareImages(const QImage &actual, const QImage &expected, int tolerance)
+{
+    Difference result;
+    result.mask = QImage(actual.size(), QImage::Format_ARGB32);
+    result.mask.fill(Qt::white);
+
+    const QImage a = actual.convertToFormat(QImage::Format_ARGB32);
+    const QImage b = expected.convertToFormat(QImage::Format_ARGB32);
+    for (int y = 0; y < a.height(); ++y) {
+        const QRgb *lineA = reinterpret_cast<const QRgb *>(a.constScanLine(y));
+        const QRgb *lineB = reinterpret_cast<const QRgb *>(b.constScanLine(y));
+        for (int x = 0; x < a.width(); ++x) {
+            const int delta = qMax(qMax(qAbs(qRed(lineA[x]) - qRed(lineB[x])),
+                                        qAbs(qGreen(lineA[x]) - qGreen(lineB[x]))),
+                                   qMax(qAbs(qBlue(lineA[x]) - qBlue(lineB[x])),
+                                        qAbs(qAlpha(lineA[x]) - qAlpha(lineB[x]))));
+            result.maxDelta = qMax(result.maxDelta, delta);
+            if (delta > tolerance) {
+                ++result.pixels;
+                result.mask.setPixel(x, y, qRgb(255, 0, 0));
+            }
+        }
+    }
+    return result;
+}
+
+void checkGolden(const QString &name, const QImage &actual)
+{
+    const QString path = QDir(DRAFT_GOLDEN_DIR).filePath(name + ".png");
+    if (envFlag("DRAFT_UPDATE_GOLDEN")) {
+        QDir().mkpath(DRAFT_GOLDEN_DIR);
+        QVERIFY2(actual.save(path), qPrintable(path));
+        return;
+    }
+
+    QImage expected;
+    if (!expected.load(path)) {
+        const QString message = QString("no golden image %1; record it with DRAFT_UPDATE_GOLDEN=1").arg(path);
+        QFAIL(qPrintable(message));
+    }
+    QCOMPARE(actual.size(), expected.size());
+
+    const Difference difference = compareImages(actual, expected, envInt("DRAFT_PIXEL_TOLERANCE", 2));
+    if (difference.pixels > 0) {
+        const QString diffDir = qEnvironmentVariable("DRAFT_DIFF_DIR", QDir::tempPath());
+        QDir().mkpath(diffDir);
+        actual.save(QDir(diffDir).filePath(name + "-actual.png"));
+        difference.mask.save(QDir(diffDir).filePath(name + "-diff.png"));
+    }
+    QVERIFY2(difference.pixels == 0,
+             qPrintable(QString("%1: %2 pixels differ, max channel delta %3")
+                            .arg(name).arg(difference.pixels).arg(difference.maxDelta)));
+}
+
+// Имя замера без пояснений в скобках, которые меняются от запуска к запуску
+QString benchmarkKey(const QString &name)
+{
+    const int bracket = name.indexOf(" (");
+    return bracket < 0 ? name : name.left(bracket);
+}
+
+// Все непрозрачные пиксели слоя лежат внутри rect
+bool layerInside(const QImage &layer, const QRect &rect)
+{
+    for (int y = 0; y < layer.height(); ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(layer.constScanLine(y));
+        for (int x = 0; x < layer.width(); ++x) {
+            if (qAlpha(line[x]) != 0 && !rect.contains(x, y))
+                return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+class DraftTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void pencilStrokes_data();
+    void pencilStrokes();
+    void hatchMaterials_data();
+    void hatchMaterials();
+    void hatchAntialiasedOutline();
+    void hatchScannedDrawing();
+    void antialiasFillStopsAtLighterPaper();
+    void overlappingAntialiasRegions();
+    void batchMatchesSingleClicks();
+    void undoRestoresCanvas();
+    void regionMeasurements();
+    void rehatchMatchesFreshHatch();
+    void nextHatchSettingsKeepExisting();
+    void patternKeysAndTileLimits();
+    void renderServicePipeline();
+    void inactiveDocumentRoundTrip();
+
+    void performanceBaseline();
+
+private:
+    bool openFixture(PaintView &view, const QImage &fixture);
+
+    QTemporaryDir m_fixtures;
+};
+
+void DraftTests::initTestCase()
+{
+    QVERIFY(m_fixtures.isValid());
+}
+
+bool DraftTests::openFixture(PaintView &view, const QImage &fixture)
+{
+    const QString path = m_fixtures.filePath("fixture.png");
+    return fixture.save(path) && view.openImage(path);
+}
+
+void DraftTests::pencilStrokes_data()
+{
+    QTest::addColumn<int>("width");
+    QTest::addColumn<bool>("smoothing");
+
+    for (int width : {1, 4, 12}) {
+        QTest::newRow(qPrintable(QString("w%1-raw").arg(width))) << width << false;
+        QTest::newRow(qPrintable(QString("w%1-smooth").arg(width))) << width << true;
+    }
+}
+
+void DraftTests::pencilStrokes()
+{
+    QFETCH(int, width);
+    QFETCH(bool, smoothing);
+
+    PaintView view;
+    view.resize(400, 400);
+    view.usePencilTool();
+    view.setPenWidth(width);
+    view.setStrokeSmoothing(smoothing);
+
+    Script script(view);
+    // Спираль из коротких отрезков и одна точка
+    QVector<QPoint> spiral;
+    for (int i = 0; i < 120; ++i) {
+        const qreal angle = i * 0.15;
+        const qreal radius = 20 + i * 1.5;
+        spiral.append(QPoint(250 + qRound(radius * std::cos(angle)), 250 + qRound(radius * std::sin(angle))));
+    }
+    script.stroke(spiral);
+    script.click(QPoint(40, 40));
+
+    checkGolden(QString("pencil-%1").arg(QTest::currentDataTag()), view.image());
+}
+
+void DraftTests::hatchMaterials_data()
+{
+    QTest::addColumn<int>("type");
+
+    const char *names[] = {"metal", "nonmetal", "wood", "stone", "ceramic",
+                           "concrete", "glass", "liquid", "soil"};
+    for (int type = HatchingTool::Metal; type <= HatchingTool::Soil; ++type)
+        QTest::newRow(names[type]) << type;
+}
+
+void DraftTests::hatchMaterials()
+{
+    QFETCH(int, type);
+
+    PaintView view;
+    view.resize(400, 400);
+    QVERIFY(openFixture(view, gridFixture()));
+    view.useHatchingTool();
+    view.setHatchType(HatchingTool::HatchType(type));
+
+    Script script(view);
+    script.click(QPoint(150, 150));
+
+    // Штриховка не выходит за ячейку
+    QVERIFY(layerInside(view.layers().image(LayerStack::HatchLayer), QRect(100, 100, Cell, Cell)));
+    checkGolden(QString("hatch-%1").arg(QTest::currentDataTag()), view.image());
+}
+
+void DraftTests::hatchAntialiasedOutline()
+{
+    PaintView view;
+    view.resize(400, 400);
+    view.usePencilTool();
+    view.setPenWidth(3);
+
+    Script script(view);
+    QVector<QPoint> circle;
+    for (int i = 0; i <= 64; ++i) {
+        const qreal angle = i * 2 * M_PI / 64;
+        circle.append(QPoint(250 + qRound(100 * std::cos(angle)), 250 + qRound(100 * std::sin(angle))));
+    }
+    script.stroke(circle);
+
+    view.useHatchingTool();
+    script.click(QPoint(250, 250));
+
+    const QImage &hatch = view.layers().image(LayerStack::HatchLayer);
+    // Штриховка есть и не выходит за окружность вместе с её сглаженным краем
+    QVERIFY(!layerInside(hatch, QRect()));
+    QVERIFY(layerInside(hatch, QRect(148, 148, 205, 205)));
+    checkGolden("hatch-antialiased-circle", view.image());
+}
+
+void DraftTests::hatchScannedDrawing()
+{
+    // Чертёж детали: контур, разрез, отверстие и паз, линии сглажены, на
+    // бумаге шум. Контуры берутся из очистки скана
+    PaintView view;
+    view.resize(600, 400);
+    view.setScanProcessing(true);
+    QVERIFY(view.openImage(QDir(DRAFT_FIXTURE_DIR).filePath("bracket.png")));
+    view.setHatchType(HatchingTool::Metal);
+
+    const QPoint hole(180, 200);
+    const QPoint slot(450, 200);
+    QCOMPARE(view.hatchSeeds({QPoint(100, 100), QPoint(450, 300)}), 2);
+    const QImage &hatch = view.layers().image(LayerStack::HatchLayer);
+    // Отверстие и паз остаются пустыми, бумага вокруг детали тоже
+    QCOMPARE(qAlpha(hatch.pixel(hole)), 0);
+    QCOMPARE(qAlpha(hatch.pixel(slot)), 0);
+    QCOMPARE(qAlpha(hatch.pixel(QPoint(20, 20))), 0);
+    QVERIFY(layerInside(hatch, QRect(60, 60, 481, 281)));
+    checkGolden("hatch-scanned-bracket", view.image());
+}
+
+void DraftTests::antialiasFillStopsAtLighterPaper()
+{
+    // Серая область вплотную к белой бумаге, чёрное перо; между серым и
+    // чёрным — столбец сглаженного края
+    QImage image(40, 10, QImage::Format_ARGB32);
+    image.fill(qRgb(200, 200, 200));
+    QPainter painter(&image);
+    painter.fillRect(QRect(20, 0, 20, 10), Qt::white);
+    painter.fillRect(QRect(0, 0, 1, 10), qRgb(150, 150, 150));
+    painter.end();
+
+    FillMask mask;
+    mask.reset(&image, 0, qRgb(200, 200, 200), qRgb(0, 0, 0), FillMask::AntialiasAware);
+    const FillRegion region = FillRegion::fromSeed(mask, QPoint(10, 5));
+    // Белое лежит за цветом области, а не между ним и пером
+    QCOMPARE(region.boundingRect(), QRect(0, 0, 20, 10));
+    QCOMPARE(region.area(), qint64(20 * 10));
+}
+
+void DraftTests::overlappingAntialiasRegions()
+{
+    // Два серых тона внутри одной чёрной рамки. Более тёмный лежит между
+    // светлым и пером, поэтому маска светлого тона включает и его: области
+    // двух точек пересекаются
+    QImage image(300, 200, QImage::Format_ARGB32);
+    image.fill(Qt::white);
+    QPainter painter(&image);
+    painter.fillRect(QRect(20, 20, 260, 160), Qt::black);
+    painter.fillRect(QRect(22, 22, 128, 156), qRgb(200, 200, 200));
+    painter.fillRect(QRect(150, 22, 128, 156), qRgb(150, 150, 150));
+    painter.end();
+    const QPoint dark(220, 100);
+    const QPoint light(80, 100);
+
+    FillMask darkMask;
+    darkMask.reset(&image, 0, image.pixel(dark), qRgb(0, 0, 0), FillMask::AntialiasAware);
+    FillMask lightMask;
+    lightMask.reset(&image, 0, image.pixel(light), qRgb(0, 0, 0), FillMask::AntialiasAware);
+    const FillRegion darkRegion = FillRegion::fromSeed(darkMask, dark);
+    const FillRegion lightRegion = FillRegion::fromSeed(lightMask, light);
+    QVERIFY(lightRegion.intersects(darkRegion));
+    QVERIFY(!darkRegion.contains(light));
+
+    // Пакет пишет пересекающиеся области по очереди: результат тот же, что
+    // у щелчков по одному, и обе области остаются в документе
+    PaintView single;
+    single.resize(300, 200);
+    QVERIFY(openFixture(single, image));
+    single.setPenColor(Qt::black);
+    single.useHatchingTool();
+    Script singleScript(single);
+    singleScript.click(dark);
+    singleScript.click(light);
+
+    PaintView batch;
+    batch.resize(300, 200);
+    QVERIFY(openFixture(batch, image));
+    batch.setPenColor(Qt::black);
+    QCOMPARE(batch.hatchSeeds({dark, light}), 2);
+    QCOMPARE(batch.image(), single.image());
+    QCOMPARE(batch.hatchedRegions().size(), 2);
+}
+
+void DraftTests::batchMatchesSingleClicks()
+{
+    const QVector<QPoint> seeds = {QPoint(150, 150), QPoint(250, 150), QPoint(150, 350), QPoint(160, 160)};
+
+    PaintView single;
+    single.resize(400, 400);
+    QVERIFY(openFixture(single, gridFixture()));
+    single.useHatchingTool();
+    Script singleScript(single);
+    for (const QPoint &seed : seeds)
+        singleScript.click(seed);
+
+    PaintView batch;
+    batch.resize(400, 400);
+    QVERIFY(openFixture(batch, gridFixture()));
+    batch.useHatchingTool();
+    Script batchScript(batch);
+    for (const QPoint &seed : seeds)
+        batchScript.click(seed, Qt::ShiftModifier);
+    batchScript.key(Qt::Key_Return);
+
+    QCOMPARE(batch.image(), single.image());
+    // Пакет отменяется одним действием
+    QCOMPARE(batch.undoStack()->count(), 1);
+}
+
+void DraftTests::undoRestoresCanvas()
+{
+    PaintView view;
+    view.resize(400, 400);
+    QVERIFY(openFixture(view, gridFixture()));
+    const QImage before = view.image();
+
+    Script script(view);
+    view.usePencilTool();
+    view.setPenWidth(5);
+    script.stroke({QPoint(20, 20), QPoint(480, 480)});
+    view.useHatchingTool();
+    script.click(QPoint(350, 150));
+    QVERIFY(view.image() != before);
+
+    while (view.undoStack()->canUndo())
+        view.undoStack()->undo();
+    QCOMPARE(view.image(), before);
+}
+
+void DraftTests::rehatchMatchesFreshHatch()
+{
+    PaintView edited;
+    edited.resize(400, 400);
+    QVERIFY(openFixture(edited, gridFixture()));
+    edited.useHatchingTool();
+    Script script(edited);
+    script.click(QPoint(150, 150));
+    script.click(QPoint(250, 150));
+    const QImage hatched = edited.image();
+    QCOMPARE(edited.hatchedRegions().size(), 2);
+    QVERIFY(edited.selectedHatches().isEmpty());
+
+    // Alt+клик выбирает вторую область; меняется только она
+    script.click(QPoint(250, 150), Qt::AltModifier);
+    QCOMPARE(edited.selectedHatches().size(), 1);
+    edited.setHatchAngle(135);
+    edited.setHatchSpacing(7);
+
+    PaintView fresh;
+    fresh.resize(400, 400);
+    QVERIFY(openFixture(fresh, gridFixture()));
+    fresh.useHatchingTool();
+    Script freshScript(fresh);
+    freshScript.click(QPoint(150, 150));
+    fresh.setHatchAngle(135);
+    fresh.setHatchSpacing(7);
+    freshScript.click(QPoint(250, 150));
+
+    QCOMPARE(edited.image(), fresh.image());
+    QCOMPARE(edited.hatchedRegions().size(), 2);
+
+    // Каждая правка — отдельная отменяемая операция
+    edited.undoStack()->undo();
+    edited.undoStack()->undo();
+    QCOMPARE(edited.image(), hatched);
+}
+
+void DraftTests::nextHatchSettingsKeepExisting()
+{
+    // Материал выбирается для следующей штриховки и не меняет уже заштрихованное
+    PaintView reference;
+    reference.resize(400, 400);
+    QVERIFY(openFixture(reference, gridFixture()));
+    reference.useHatchingTool();
+    Script(reference).click(QPoint(150, 150));
+
+    PaintView view;
+    view.resize(400, 400);
+    QVERIFY(openFixture(view, gridFixture()));
+    view.useHatchingTool();
+    Script script(view);
+    script.click(QPoint(150, 150));
+    view.setHatchType(HatchingTool::Wood);
+    script.click(QPoint(250, 150));
+
+    const QRect first(Cell + 2, Cell + 2, Cell - 4, Cell - 4);
+    QCOMPARE(view.image().copy(first), reference.image().copy(first));
+    const QRect second = first.translated(Cell, 0);
+    QVERIFY(view.image().copy(second) != reference.image().copy(second));
+    QCOMPARE(view.undoStack()->count(), 2);
+
+    // Выбор области переносит в инструмент весь её рисунок, включая материал
+    script.click(QPoint(150, 150), Qt::AltModifier);
+    QCOMPARE(view.hatchType(), HatchingTool::Metal);
+    script.click(QPoint(250, 150), Qt::AltModifier);
+    QCOMPARE(view.hatchType(), HatchingTool::Wood);
+    QCOMPARE(view.hatchAngle(), view.hatchedRegions().last().pattern.angle);
+    QCOMPARE(view.hatchSpacing(), view.hatchedRegions().last().pattern.spacing);
+    QCOMPARE(view.undoStack()->count(), 2);
+}
+
+void DraftTests::patternKeysAndTileLimits()
+{
+    // Шаг и толщина ограничиваются инструментом, а не обрезаются в ключе
+    HatchingTool tool;
+    tool.setHatchSpacing(300);
+    tool.setPenWidth(100);
+    QCOMPARE(tool.getHatchSpacing(), HatchPattern::MaxSpacing);
+    QCOMPARE(tool.penWidth(), HatchPattern::MaxPenWidth);
+
+    QSet<quint64> keys;
+    HatchPattern pattern;
+    for (int spacing = 1; spacing <= HatchPattern::MaxSpacing; ++spacing) {
+        for (int width = 1; width <= HatchPattern::MaxPenWidth; ++width) {
+            pattern.spacing = spacing;
+            pattern.penWidth = width;
+            keys.insert(pattern.key());
+        }
+    }
+    QCOMPARE(keys.size(), HatchPattern::MaxSpacing * HatchPattern::MaxPenWidth);
+
+    // При наибольшем шаге плитка любого материала укладывается в 512×512
+    HatchPatternCache cache;
+    for (int type = HatchingTool::Metal; type <= HatchingTool::Soil; ++type) {
+        tool.setHatchType(HatchingTool::HatchType(type));
+        tool.setHatchSpacing(HatchPattern::MaxSpacing);
+        for (int angle = 0; angle < 180; angle += 15) {
+            tool.setHatchAngle(angle);
+            const QImage &tile = cache.tile(tool.currentPattern());
+            QVERIFY2(qint64(tile.width()) * tile.height() <= 512 * 512,
+                     qPrintable(QString("type %1, angle %2: %3x%4").arg(type).arg(angle)
+                                    .arg(tile.width()).arg(tile.height())));
+        }
+    }
+}
+
+void DraftTests::regionMeasurements()
+{
+    // Квадрат 40×40 в рамке толщиной 1 с дырой 10×10 в углу (20..29, 20..29)
+    QImage image(60, 60, QImage::Format_ARGB32);
+    image.fill(Qt::black);
+    QPainter painter(&image);
+    painter.fillRect(QRect(10, 10, 40, 40), Qt::white);
+    painter.fillRect(QRect(20, 20, 10, 10), Qt::black);
+    painter.end();
+
+    const FillRegion region = FillRegion::fromSeed(image, QPoint(45, 45));
+    QCOMPARE(region.area(), qint64(40 * 40 - 10 * 10));
+    QCOMPARE(region.perimeter(), qint64(4 * 40 + 4 * 10));
+    QCOMPARE(region.boundingRect(), QRect(10, 10, 40, 40));
+    // Центр квадрата (30, 30) минус дыра с центром (25, 25)
+    const qreal expected = (1600 * 30.0 - 100 * 25.0) / 1500;
+    QVERIFY(qFuzzyCompare(region.centroid().x(), expected));
+    QVERIFY(qFuzzyCompare(region.centroid().y(), expected));
+
+    HatchingTool tool;
+    tool.setMeasurementScale(254, 10);
+    const FillRegion hole = FillRegion::fromSeed(image, QPoint(25, 25));
+    const HatchingTool::Measurement m = tool.measure({region, hole});
+    QCOMPARE(m.regions, 2);
+    QCOMPARE(m.area, qint64(1600));
+    QVERIFY(qFuzzyCompare(m.centroid.x(), 30.0));
+    // 254 dpi при масштабе 1:10 — миллиметр натуры на пиксель
+    QVERIFY(qFuzzyCompare(m.areaMm2(), 1600.0));
+    QVERIFY(qFuzzyCompare(m.boundsMm().width(), 40.0));
+}
+
+void DraftTests::inactiveDocumentRoundTrip()
+{
+    // Два документа с общим кэшем плиток, как вкладки главного окна
+    auto cache = std::make_shared<HatchPatternCache>();
+    PaintView first;
+    PaintView second;
+    for (PaintView *view : {&first, &second}) {
+        view->resize(400, 400);
+        view->setPatternCache(cache);
+        QVERIFY(openFixture(*view, gridFixture()));
+        view->useHatchingTool();
+    }
+
+    Script script(first);
+    script.click(QPoint(150, 150));
+    const QImage hatched = first.image();
+    const qint64 unpackedBytes = first.layers().layerBytes();
+
+    first.setActive(false);
+    QVERIFY(first.layers().isPacked());
+    QVERIFY(first.layers().layerBytes() < unpackedBytes / 4);
+
+    // Плитка, построенная для первого документа, берётся из кэша
+    const int hits = cache->stats().hits;
+    Script(second).click(QPoint(150, 150));
+    QVERIFY(cache->stats().hits > hits);
+
+    first.setActive(true);
+    QVERIFY(!first.layers().isPacked());
+    QCOMPARE(first.image(), hatched);
+    QCOMPARE(second.image(), hatched);
+    first.undoStack()->undo();
+    QVERIFY(first.image() != hatched);
+}
+
+void DraftTests::renderServicePipeline()
+{
+    const QString fixture = m_fixtures.filePath("service.png");
+    // Пробел в пути передаётся как есть
+    const QString exported = m_fixtures.filePath("service out.png");
+    QVERIFY(gridFixture().save(fixture));
+
+    RenderService service;
+    const QString name = QStringLiteral("draft-tests-%1").arg(QCoreApplication::applicationPid());
+    QVERIFY2(service.listen(name), qPrintable(service.errorString()));
+    // Второй экземпляр не отбирает сокет у работающего
+    RenderService second;
+    QVERIFY(!second.listen(name));
+
+    QLocalSocket client;
+    client.connectToServer(name);
+    QVERIFY(client.waitForConnected(1000));
+
+    // Весь пакет уходит одной записью, не дожидаясь ответов
+    const QByteArray batch = "open a " + fixture.toUtf8() + "\n"
+                             "hatch a metal 150,150 250,150\n"
+                             "stroke a 3 10,10 120,90\n"
+                             "hatch a glass 5000,5000\n"
+                             "bogus\n"
+                             "stroke a 51 10,10 120,90\n"
+                             "hatch a metal 150,99999999\n"
+                             "export a " + exported.toUtf8() + "\n"
+                             "stats\n";
+    client.write(batch);
+
+    QList<QByteArray> responses;
+    QTRY_VERIFY_WITH_TIMEOUT(([&]() {
+        while (client.canReadLine())
+            responses.append(client.readLine().trimmed());
+        return responses.size() >= 9;
+    }()), 10000);
+
+    QCOMPARE(responses.size(), 9);
+    QVERIFY(responses[0].startsWith("ok "));
+    QVERIFY(responses[1].startsWith("ok "));
+    QVERIFY(responses[1].contains("regions=2"));
+    QVERIFY(responses[2].startsWith("ok "));
+    // Точка вне холста — не ошибка, просто нет областей
+    QVERIFY(responses[3].contains("regions=0"));
+    QVERIFY(responses[4].startsWith("error "));
+    // Толщина и координаты за пределами диалогов отклоняются
+    QVERIFY(responses[5].startsWith("error "));
+    QVERIFY(responses[5].contains("pen width"));
+    QVERIFY(responses[6].startsWith("error "));
+    QVERIFY(responses[7].startsWith("ok "));
+    QVERIFY(responses[8].contains("documents=1"));
+    QVERIFY(QImage(exported).size() == gridFixture().size());
+}
+
+void DraftTests::performanceBaseline()
+{
+    const QVector<Benchmark::Result> results = Benchmark::runAll();
+
+    if (envFlag("DRAFT_UPDATE_BASELINE")) {
+        QFile file(DRAFT_PERF_BASELINE);
+        QVERIFY2(file.open(QIODevice::WriteOnly | QIODevice::Text), DRAFT_PERF_BASELINE);
+        QTextStream out(&file);
+        for (const Benchmark::Result &result : results)
+            out << benchmarkKey(result.name) << '\t' << result.nsPerOp << '\t' << result.operations << '\n';
+        return;
+    }
+
+    QFile file(DRAFT_PERF_BASELINE);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        QFAIL("no performance baseline; record it with DRAFT_UPDATE_BASELINE=1");
+    }
+
+    QHash<QString, double> baseline;
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        const QStringList fields = in.readLine().split('\t');
+        if (fields.size() >= 2)
+            baseline.insert(fields[0], fields[1].toDouble());
+    }
+
+    const int tolerance = envInt("DRAFT_PERF_TOLERANCE", 25);
+    QStringList regressions;
+    for (const Benchmark::Result &result : results) {
+        const QString key = benchmarkKey(result.name);
+        if (!baseline.contains(key) || result.nsPerOp * result.operations < MinMeasuredNs)
+            continue;
+        const double expected = baseline.value(key);
+        if (result.nsPerOp > expected * (100 + tolerance) / 100)
+            regressions.append(QString("%1: %2 ns/op, baseline %3 ns/op")
+                                   .arg(key).arg(result.nsPerOp, 0, 'f', 1).arg(expected, 0, 'f', 1));
+    }
+    QVERIFY2(regressions.isEmpty(),
+             qPrintable(QString("slower than baseline by more than %1%:\n").arg(tolerance)
+                        + regressions.join('\n')));
+}
+
+QTEST_MAIN(DraftTests)
+#include "drafttests.moc"
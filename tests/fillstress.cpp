@@ -0,0 +1,397 @@
+// Нагрузочная проверка заливки на патологических контурах: спирали,
+// шахматная доска, гребёнка коридоров в один пиксель, перколяционный шум.
+// Для каждого случая печатаются время, число отрезков и пик памяти арены;
+// случайные изображения дополнительно сверяются с простым обходом в ширину.
+// Имеет смысл запускать в сборке с DRAFT_SANITIZE=ON.
+
+#include "arena.h"
+#include "fillmask.h"
+#include "fillregion.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <QVector>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+const QRgb Ink = 0xff000000;
+const QRgb Paper = 0xffffffff;
+
+QImage blankSheet(int size)
+{
+    QImage image(size, size, QImage::Format_RGB32);
+    image.fill(Paper);
+    return image;
+}
+
+inline void setInk(QImage &image, int x, int y)
+{
+    reinterpret_cast<QRgb *>(image.scanLine(y))[x] = Ink;
+}
+
+// Прямоугольная спираль из стенок в пиксель с коридором в пиксель:
+// одна область, по которой заливка идёт очень короткими отрезками
+QImage spiral(int size)
+{
+    QImage image = blankSheet(size);
+    const int dx[] = {1, 0, -1, 0};
+    const int dy[] = {0, 1, 0, -1};
+    int x = 0;
+    int y = 0;
+    int length = size - 1;
+    setInk(image, x, y);
+    for (int turn = 0; length > 0; ++turn) {
+        const int dir = turn % 4;
+        for (int i = 0; i < length; ++i) {
+            x += dx[dir];
+            y += dy[dir];
+            setInk(image, x, y);
+        }
+        // После первых трёх сторон каждая пара сторон короче на два
+        if (turn >= 2 && turn % 2 == 0)
+            length -= 2;
+    }
+    return image;
+}
+
+// Шахматная доска в пиксель: каждая клетка — отдельная область
+QImage checkerboard(int size)
+{
+    QImage image = blankSheet(size);
+    for (int y = 0; y < size; ++y) {
+        for (int x = (y + 1) % 2; x < size; x += 2)
+            setInk(image, x, y);
+    }
+    return image;
+}
+
+// Змейка вертикальных коридоров в пиксель: в каждой строке много отрезков
+// единичной длины, все в одной области
+QImage comb(int size)
+{
+    QImage image = blankSheet(size);
+    for (int x = 1; x < size; x += 2) {
+        const bool fromTop = (x / 2) % 2 == 0;
+        for (int y = fromTop ? 0 : 1; y < (fromTop ? size - 1 : size); ++y)
+            setInk(image, x, y);
+    }
+    return image;
+}
+
+// Случайные чернила с плотностью около порога перколяции: тысячи мелких
+// областей и несколько огромных фрактальной формы с множеством дыр
+QImage percolation(int size, quint32 seed)
+{
+    QImage image = blankSheet(size);
+    QRandomGenerator rng(seed);
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            if (rng.bounded(1000) < 407)
+                setInk(image, x, y);
+        }
+    }
+    return image;
+}
+
+// Концентрические квадраты без разрывов: вложенные области
+QImage rings(int size)
+{
+    QImage image = blankSheet(size);
+    for (int d = 0; d < size / 2; d += 2) {
+        for (int i = d; i < size - d; ++i) {
+            setInk(image, i, d);
+            setInk(image, i, size - 1 - d);
+            setInk(image, d, i);
+            setInk(image, size - 1 - d, i);
+        }
+    }
+    return image;
+}
+
+// Диагональные полосы шириной два пикселя: много узких наклонных областей
+QImage diagonals(int size)
+{
+    QImage image = blankSheet(size);
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            if ((x + y) % 3 == 0)
+                setInk(image, x, y);
+        }
+    }
+    return image;
+}
+
+struct Case
+{
+    const char *name;
+    std::function<QImage(int)> generate;
+    // Залить все области листа с общей картой обхода, а не одну от точки
+    bool allRegions;
+};
+
+struct Outcome
+{
+    qint64 nsecs = 0;
+    int regions = 0;
+    qint64 area = 0;
+    qint64 spans = 0;
+    qint64 arenaPeak = 0;
+    qint64 resultBytes = 0;
+};
+
+QPoint firstPaper(const QImage &image)
+{
+    for (int y = 0; y < image.height(); ++y) {
+        for (int x = 0; x < image.width(); ++x) {
+            if (image.pixel(x, y) == Paper)
+                return QPoint(x, y);
+        }
+    }
+    return QPoint(-1, -1);
+}
+
+Outcome runCase(const Case &test, const QImage &image)
+{
+    // Арена освобождается, чтобы её ёмкость после заливки была пиком случая
+    Arena &arena = Arena::local();
+    arena.release();
+
+    Outcome outcome;
+    FillMask mask;
+    QElapsedTimer timer;
+    timer.start();
+    if (test.allRegions) {
+        mask.reset(&image, 0, Paper, Ink, FillMask::ExactMatch);
+        ArenaScope scope(arena);
+        const size_t visitedSize = size_t(image.width()) * size_t(image.height());
+        uchar *visited = arena.allocateArray<uchar>(visitedSize);
+        std::memset(visited, 0, visitedSize);
+        for (int y = 0; y < image.height(); ++y) {
+            const uchar *row = mask.row(y);
+            for (int x = 0; x < image.width(); ++x) {
+                if (visited[size_t(y) * size_t(image.width()) + x] || !row[x])
+                    continue;
+                const FillRegion region = FillRegion::fromSeed(mask, QPoint(x, y), visited);
+                ++outcome.regions;
+                outcome.area += region.area();
+                outcome.spans += region.spans().size();
+                outcome.resultBytes = qMax<qint64>(outcome.resultBytes, region.spans().size() * qint64(sizeof(FillSpan)));
+            }
+        }
+    } else {
+        const FillRegion region = FillRegion::fromSeed(image, firstPaper(image));
+        outcome.regions = 1;
+        outcome.area = region.area();
+        outcome.spans = region.spans().size();
+        outcome.resultBytes = region.spans().size() * qint64(sizeof(FillSpan));
+    }
+    outcome.nsecs = timer.nsecsElapsed();
+    outcome.arenaPeak = qint64(arena.capacity());
+    return outcome;
+}
+
+// Эталон: обход в ширину по пикселям без всяких оптимизаций
+struct Reference
+{
+    qint64 area = 0;
+    qint64 perimeter = 0;
+    double cx = 0;
+    double cy = 0;
+    QRect bounds;
+};
+
+Reference referenceFill(const QImage &image, const QPoint &seed)
+{
+    Reference ref;
+    const int w = image.width();
+    const int h = image.height();
+    const QRgb target = image.pixel(seed);
+    QVector<char> inside(w * h, 0);
+    QVector<int> queue{seed.y() * w + seed.x()};
+    inside[queue.first()] = 1;
+    for (int head = 0; head < queue.size(); ++head) {
+        const int x = queue[head] % w;
+        const int y = queue[head] / w;
+        const QPoint neighbours[] = {{x + 1, y}, {x - 1, y}, {x, y + 1}, {x, y - 1}};
+        for (const QPoint &n : neighbours) {
+            if (n.x() < 0 || n.y() < 0 || n.x() >= w || n.y() >= h)
+                continue;
+            const int i = n.y() * w + n.x();
+            if (!inside[i] && image.pixel(n) == target) {
+                inside[i] = 1;
+                queue.append(i);
+            }
+        }
+    }
+
+    for (int i : std::as_const(queue)) {
+        const int x = i % w;
+        const int y = i / w;
+        ++ref.area;
+        ref.cx += x + 0.5;
+        ref.cy += y + 0.5;
+        ref.bounds |= QRect(x, y, 1, 1);
+        const QPoint neighbours[] = {{x + 1, y}, {x - 1, y}, {x, y + 1}, {x, y - 1}};
+        for (const QPoint &n : neighbours) {
+            if (n.x() < 0 || n.y() < 0 || n.x() >= w || n.y() >= h || !inside[n.y() * w + n.x()])
+                ++ref.perimeter;
+        }
+    }
+    ref.cx /= ref.area;
+    ref.cy /= ref.area;
+    return ref;
+}
+
+// Случайные листы разного размера и плотности; возвращает число расхождений
+int fuzz(int iterations, quint32 seed, QTextStream &out)
+{
+    QRandomGenerator rng(seed);
+    int failures = 0;
+    for (int it = 0; it < iterations; ++it) {
+        const int w = rng.bounded(1, 65);
+        const int h = rng.bounded(1, 65);
+        const int density = rng.bounded(0, 1000);
+        QImage image(w, h, QImage::Format_RGB32);
+        for (int y = 0; y < h; ++y) {
+            QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+            for (int x = 0; x < w; ++x)
+                line[x] = rng.bounded(1000) < density ? Ink : Paper;
+        }
+        const QPoint seedPoint(rng.bounded(w), rng.bounded(h));
+
+        const FillRegion region = FillRegion::fromSeed(image, seedPoint);
+        const Reference ref = referenceFill(image, seedPoint);
+
+        // Отрезки отсортированы и не пересекаются
+        bool ordered = true;
+        const QVector<FillSpan> &spans = region.spans();
+        for (int i = 1; i < spans.size(); ++i) {
+            const FillSpan &a = spans[i - 1];
+            const FillSpan &b = spans[i];
+            ordered = ordered && (a.y < b.y || (a.y == b.y && a.x2 < b.x1));
+        }
+
+        const bool ok = ordered && region.area() == ref.area && region.perimeter() == ref.perimeter
+                        && region.boundingRect() == ref.bounds
+                        && std::abs(region.centroid().x() - ref.cx) < 1e-9
+                        && std::abs(region.centroid().y() - ref.cy) < 1e-9;
+        if (!ok) {
+            ++failures;
+            out << "fuzz mismatch: iteration " << it << " seed " << seed << " size " << w << "x" << h
+                << " at " << seedPoint.x() << "," << seedPoint.y() << " area " << region.area() << "/"
+                << ref.area << " perimeter " << region.perimeter() << "/" << ref.perimeter << Qt::endl;
+        }
+    }
+    return failures;
+}
+
+qint64 peakResidentKiB()
+{
+#ifdef Q_OS_UNIX
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef Q_OS_MACOS
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return -1;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Fill stress and fuzz harness.");
+    parser.addHelpOption();
+    QCommandLineOption quickOption("quick", "Small sheets and fewer fuzz iterations (for CTest).");
+    parser.addOption(quickOption);
+    QCommandLineOption fuzzOption("fuzz", "Number of random fuzz cases.", "count", "2000");
+    parser.addOption(fuzzOption);
+    QCommandLineOption seedOption("seed", "Random seed for generators and fuzzing.", "seed", "1");
+    parser.addOption(seedOption);
+    QCommandLineOption csvOption("csv", "Append per-case results to a CSV file.", "file");
+    parser.addOption(csvOption);
+    parser.process(app);
+
+    const bool quick = parser.isSet(quickOption);
+    const quint32 seed = parser.value(seedOption).toUInt();
+    const QVector<int> sizes = quick ? QVector<int>{257} : QVector<int>{513, 2049, 4097};
+
+    const Case cases[] = {
+        {"open", blankSheet, false},
+        {"spiral", spiral, false},
+        {"comb", comb, false},
+        {"percolation", [seed](int size) { return percolation(size, seed); }, true},
+        {"checkerboard", checkerboard, true},
+        {"rings", rings, true},
+        {"diagonals", diagonals, true},
+    };
+
+    QTextStream out(stdout);
+    QFile csv(parser.value(csvOption));
+    QTextStream csvOut;
+    if (parser.isSet(csvOption)) {
+        const bool existed = csv.exists();
+        if (!csv.open(QIODevice::Append | QIODevice::Text)) {
+            out << "cannot open " << csv.fileName() << Qt::endl;
+            return 2;
+        }
+        csvOut.setDevice(&csv);
+        if (!existed)
+            csvOut << "case,size,ms,regions,area,spans,arena_kib,result_kib\n";
+    }
+
+    out << qSetFieldWidth(14) << Qt::left << "case" << qSetFieldWidth(8) << "size"
+        << qSetFieldWidth(12) << "ms" << "regions" << "spans" << "arena KiB" << "result KiB"
+        << qSetFieldWidth(0) << Qt::endl;
+
+    int failures = 0;
+    for (const Case &test : cases) {
+        for (int size : sizes) {
+            const QImage image = test.generate(size);
+            const Outcome r = runCase(test, image);
+
+            // Память заливки линейна по площади: карта обхода, стек не длиннее
+            // двух точек на пиксель, отрезки и удвоение векторов в арене
+            const qint64 pixels = qint64(size) * size;
+            const qint64 bound = pixels + 64 * r.area + 1024 * 1024;
+            const bool withinBound = r.arenaPeak <= bound;
+            failures += !withinBound;
+
+            out << qSetFieldWidth(14) << test.name << qSetFieldWidth(8) << size << qSetFieldWidth(12)
+                << QString::number(r.nsecs / 1e6, 'f', 2) << r.regions << r.spans << r.arenaPeak / 1024
+                << r.resultBytes / 1024 << qSetFieldWidth(0) << (withinBound ? "" : "  OVER BOUND")
+                << Qt::endl;
+            if (csvOut.device()) {
+                csvOut << test.name << ',' << size << ',' << QString::number(r.nsecs / 1e6, 'f', 3) << ','
+                       << r.regions << ',' << r.area << ',' << r.spans << ',' << r.arenaPeak / 1024 << ','
+                       << r.resultBytes / 1024 << '\n';
+            }
+        }
+    }
+
+    const int iterations = quick ? 300 : parser.value(fuzzOption).toInt();
+    const int mismatches = fuzz(iterations, seed, out);
+    out << "fuzz: " << iterations << " cases, " << mismatches << " mismatches" << Qt::endl;
+    out << "peak RSS: " << peakResidentKiB() << " KiB" << Qt::endl;
+
+    return failures + mismatches == 0 ? 0 : 1;
+}
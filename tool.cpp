@@ -3,3 +3,10 @@
 Tool::Tool(QObject *parent) : QObject(parent)
 {
 }
+
+QRect Tool::takeDirtyRect()
+{
+    const QRect rect = m_dirtyRect;
+    m_dirtyRect = QRect();
+    return rect;
+}
@@ -5,6 +5,9 @@
 #include <QMouseEvent>
 #include <QPainter>
 #include <QPoint>
+#include <QRect>
+#include <functional>
+#include "layerstack.h"
 
 class Tool : public QObject
 {
@@ -17,15 +20,36 @@ public:
     virtual void onMouseMove(QMouseEvent *event, QPainter &painter, const QPoint &lastPoint) = 0;
     virtual void onMouseRelease(QMouseEvent *event, QPainter &painter, const QPoint &lastPoint) = 0;
 
+    // Слой, на котором рисует инструмент
+    virtual LayerStack::LayerId targetLayer() const { return LayerStack::OutlineLayer; }
+
     virtual void setPenColor(const QColor &color) { m_penColor = color; }
     virtual void setPenWidth(int width) { m_penWidth = width; }
 
     QColor penColor() const { return m_penColor; }
     int penWidth() const { return m_penWidth; }
 
+    // Область, изменённая с прошлого вызова
+    QRect takeDirtyRect();
+
+    // Вызывается до записи в слой с прямоугольником, который инструмент
+    // собирается изменить; по нему сохраняются пиксели для отмены
+    void setWriteHandler(const std::function<void(const QRect &)> &handler) { m_writeHandler = handler; }
+
 protected:
+    void addDirtyRect(const QRect &rect) { m_dirtyRect |= rect; }
+    void aboutToWrite(const QRect &rect)
+    {
+        if (m_writeHandler)
+            m_writeHandler(rect);
+    }
+
     QColor m_penColor = Qt::blue;
     int m_penWidth = 1;
+
+private:
+    QRect m_dirtyRect;
+    std::function<void(const QRect &)> m_writeHandler;
 };
 
 #endif // TOOL_H